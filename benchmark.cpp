@@ -0,0 +1,1345 @@
+/*
+ * Microbenchmarks for the referee of "Schiffe versenken".
+ *
+ * The referee is compiled into this program (without its main function), so
+ * its classes can be exercised directly.  Run with:
+ *
+ *     make bench                  # or: make bench-release (-O2 -flto)
+ *     ./benchmark [--json] [GRUPPE...]
+ *
+ * GRUPPE is one of board, fleet, getline, parse, record, game, spawn,
+ * registry, metrics, ai, latency; without any, all groups run.  With --json,
+ * every result is printed as one JSON object per line, which is easy to
+ * collect for tracking regressions.
+ */
+#define SCHIFFE_VERSENKEN_NO_MAIN
+#include "schiffe_versenken.cpp"
+#include "flotten_index.h"
+
+#include <list>
+#include <random>
+#include <set>
+#include <sstream>
+
+#ifndef BENCHMARK_BUILD
+#define BENCHMARK_BUILD "unbekannt"
+#endif
+
+/**
+ * Board of the referee up to version 1.1, which stores one char per field.
+ * Kept as a baseline for the bit mask representation in Player.
+ */
+class LegacyBoard
+{
+public:
+    LegacyBoard() : _live(0) { std::fill_n(&_board[0][0], 100, ' '); }
+
+    bool alive() const { return _live > 0; }
+
+    void check_valid(int r, int c) const {
+        if (r < 0 || r > 9)
+            throw std::runtime_error("Ungueltige Zeile");
+        if (c < 0 || c > 9)
+            throw std::runtime_error("Ungueltige Spalte");
+        if (r != 0 && _board[r-1][c] != ' ')
+            throw std::runtime_error("Schiff beruehrt oben anderes Schiff");
+        if (r != 9 && _board[r+1][c] != ' ')
+            throw std::runtime_error("Schiff beruehrt unten anderes Schiff");
+        if (c != 0 && _board[r][c-1] != ' ')
+            throw std::runtime_error("Schiff beruehrt links anderes Schiff");
+        if (c != 9 && _board[r][c+1] != ' ')
+            throw std::runtime_error("Schiff beruehrt rechts anderes Schiff");
+    }
+
+    char board(int r, int c) const { return _board[r][c]; }
+
+    void place(int r, int c, int size, bool downward) {
+        if (size <= 0)
+            throw std::runtime_error("Ungueltige Groesse");
+        if (downward) {
+            if (r > 6)
+                throw std::runtime_error("Schiff hat nach unten nicht Platz.");
+            for (int rr = r; rr != r + size; ++rr)
+                check_valid(rr, c);
+            for (int rr = r; rr != r + size; ++rr)
+                _board[rr][c] = 'S';
+        } else {
+            if (c > 6)
+                throw std::runtime_error("Schiff hat nach rechts nicht Platz.");
+            for (int cc = c; cc != c + size; ++cc)
+                check_valid(r, cc);
+            for (int cc = c; cc != c + size; ++cc)
+                _board[r][cc] = 'S';
+        }
+        _live += size;
+    }
+
+    Player::Outcome incoming(int r, int c) {
+        if (r < 0 || r > 9)
+            throw std::runtime_error("Ungueltige Zeile");
+        if (c < 0 || c > 9)
+            throw std::runtime_error("Ungueltige Spalte");
+
+        if (_board[r][c] == 'S') {
+            _board[r][c] = 'X';
+            --_live;
+            return _has_alive_ship(r, c) ? Player::HIT : Player::SUNK;
+        } else {
+            if (_board[r][c] == ' ')
+                _board[r][c] = 'o';
+            return Player::MISS;
+        }
+    }
+
+private:
+    bool _has_alive_ship(int r, int c) {
+        if (_board[r][c] == 'S')
+            return true;
+        if (_board[r][c] != 'X')
+            return false;
+        for (int rr = r-1; rr >= 0; --rr) {
+            if (_board[rr][c] == 'S')
+                return true;
+            if (_board[rr][c] != 'X')
+                break;
+        }
+        for (int rr = r+1; rr <= 9; ++rr) {
+            if (_board[rr][c] == 'S')
+                return true;
+            if (_board[rr][c] != 'X')
+                break;
+        }
+        for (int cc = c-1; cc >= 0; --cc) {
+            if (_board[r][cc] == 'S')
+                return true;
+            if (_board[r][cc] != 'X')
+                break;
+        }
+        for (int cc = c+1; cc <= 9; ++cc) {
+            if (_board[r][cc] == 'S')
+                return true;
+            if (_board[r][cc] != 'X')
+                break;
+        }
+        return false;
+    }
+
+    char _board[10][10];
+    int _live;
+};
+
+/**
+ * Line reader of the referee up to version 1.1, which reads at most one line
+ * length per read() and copies every line out of a std::string buffer.
+ */
+class LegacyLineReader
+{
+public:
+    std::string getline(const Pipe &pipe, int maxlen, int timeout) {
+        std::vector<char> buffer(maxlen+1);
+        for(int tries=0; tries != 3; ++tries) {
+            size_t linesize = _buffer.find('\n');
+            if (linesize != std::string::npos) {
+                std::string line = _buffer.substr(0, linesize+1);
+                _buffer = _buffer.substr(linesize+1);
+                return line;
+            }
+
+            pollfd poll_info;
+            poll_info.fd = pipe.fd_read();
+            poll_info.events = POLLIN;
+            if (checked(poll(&poll_info, 1, timeout)) == 0)
+                throw std::runtime_error("Timeout");
+
+            int nbytes = pipe.read(buffer.data(), maxlen);
+            buffer[nbytes] = '\0';
+            _buffer += std::string(buffer.data());
+        }
+        throw std::runtime_error("Zu lange Zeilen");
+    }
+
+private:
+    std::string _buffer;
+};
+
+/** Move parsing of the referee up to version 1.1, which returns `ok` */
+struct LegacyParser
+{
+    static bool placement(const LineView &line, int &i, int &j, char &c) {
+        std::istringstream linestr(line.str());
+        linestr >> i >> j >> c >> std::ws;
+        return linestr.eof() && !linestr.fail();
+    }
+
+    static bool shot(const LineView &line, int &i, int &j) {
+        std::istringstream linestr(line.str());
+        linestr >> i >> j >> std::ws;
+        return linestr.eof() && !linestr.fail();
+    }
+};
+
+/** The same grammar parsed with the LineScanner of the referee */
+struct ScannerParser
+{
+    static bool placement(const LineView &line, int &i, int &j, char &c) {
+        LineScanner scan(line);
+        scan >> i >> j >> c;
+        return scan.done();
+    }
+
+    static bool shot(const LineView &line, int &i, int &j) {
+        LineScanner scan(line);
+        scan >> i >> j;
+        return scan.done();
+    }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsed_ns(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+/** Whether results are printed as JSON lines instead of a table */
+bool json_output = false;
+
+void report(const std::string &name, double ns, long ops)
+{
+    if (json_output) {
+        std::cout << "{\"benchmark\":\"" << name << "\",\"build\":\""
+                  << BENCHMARK_BUILD << "\",\"ns_per_op\":" << std::fixed
+                  << std::setprecision(3) << ns / ops << ",\"ops\":" << ops
+                  << "}\n";
+        return;
+    }
+    std::cout << std::left << std::setw(28) << name << std::right
+              << std::fixed << std::setprecision(2) << std::setw(12)
+              << ns / ops << " ns/op" << std::setw(14) << std::setprecision(0)
+              << ops * 1e9 / ns << " op/s  (" << ops << " ops)\n";
+}
+
+/** A few thousand random legal fleets, as (r, c, downward) per ship */
+struct Fleet { int r[4], c[4]; bool down[4]; };
+
+std::vector<Fleet> random_fleets(std::mt19937 &rng, int count)
+{
+    std::vector<Fleet> fleets;
+    std::uniform_int_distribution<int> coord(0, 9);
+    while ((int)fleets.size() != count) {
+        Player board('A');
+        Fleet fleet;
+        for (int ship = 0; ship != 4; ) {
+            fleet.r[ship] = coord(rng);
+            fleet.c[ship] = coord(rng);
+            fleet.down[ship] = coord(rng) % 2;
+            try {
+                board.place(fleet.r[ship], fleet.c[ship], 4, fleet.down[ship]);
+                ++ship;
+            } catch(const std::runtime_error &e) { }
+        }
+        fleets.push_back(fleet);
+    }
+    return fleets;
+}
+
+/** The fields covered by `fleet`, as in the index of all fleets */
+flotten::Flotte fleet_mask(const Fleet &fleet)
+{
+    flotten::Flotte mask = {0, 0};
+    for (int ship = 0; ship != 4; ++ship) {
+        for (int k = 0; k != 4; ++k)
+            mask = mask | flotten::Flotte::feld(
+                              fleet.r[ship] + k * fleet.down[ship],
+                              fleet.c[ship] + k * !fleet.down[ship]);
+    }
+    return mask;
+}
+
+/**
+ * Builds, writes and maps the index of all fleets, and compares sampling
+ * from it with placing random ships until they fit.  Returns the number of
+ * errors found.
+ */
+long bench_fleets(std::mt19937 &rng, const std::vector<Fleet> &fleets)
+{
+    long errors = 0;
+    double best = 1e300;
+    std::vector<flotten::Flotte> all;
+    for (int run = 0; run != 5; ++run) {
+        Clock::time_point start = Clock::now();
+        all = flotten::FlottenIndex::aufzaehlen();
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("fleet index build", best, all.size());
+    errors += all.size() != flotten::FlottenIndex::ANZAHL;
+
+    char path[] = "/tmp/benchmark_XXXXXX";
+    ::close(checked(mkstemp(path)));
+    flotten::FlottenIndex::schreiben(path, all);
+    flotten::FlottenIndex index(path);
+    unlink(path);
+    errors += index.anzahl() != all.size()
+              || !std::equal(all.begin(), all.end(), &index[0]);
+
+    // Every fleet the referee accepts is in the index, one more field is not
+    best = 1e300;
+    long found = 0;
+    for (int run = 0; run != 5; ++run) {
+        found = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i != fleets.size(); ++i)
+            found += index.enthaelt(fleet_mask(fleets[i]));
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("fleet lookup", best, fleets.size());
+    errors += found != long(fleets.size());
+    for (size_t i = 0; i != fleets.size(); ++i) {
+        flotten::Flotte more = fleet_mask(fleets[i]);
+        more = more | flotten::Flotte::feld(i % 10, i / 10 % 10);
+        errors += index.enthaelt(more) && !(more == fleet_mask(fleets[i]));
+    }
+
+    best = 1e300;
+    std::vector<Fleet> placed;
+    for (int run = 0; run != 5; ++run) {
+        Clock::time_point start = Clock::now();
+        placed = random_fleets(rng, 20000);
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("random fleet (placing)", best, placed.size());
+
+    best = 1e300;
+    uint64_t checksum = 0;
+    for (int run = 0; run != 5; ++run) {
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i != 20000; ++i)
+            checksum += index.zufaellig(rng).lo;
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("random fleet (index)", best, 20000);
+
+    // Observations from shooting at a fleet: it has to stay among the
+    // consistent ones, which become fewer with every shot
+    size_t target = std::lower_bound(all.begin(), all.end(),
+                                     fleet_mask(fleets[0])) - all.begin();
+    std::uniform_int_distribution<int> field(0, 99);
+    flotten::Flotte hits = {0, 0}, misses = {0, 0};
+    for (int k = 0; k != 10; ++k) {
+        int r = field(rng) / 10, c = field(rng) % 10;
+        if (all[target].test(r, c))
+            hits = hits | flotten::Flotte::feld(r, c);
+        else
+            misses = misses | flotten::Flotte::feld(r, c);
+    }
+    best = 1e300;
+    std::vector<uint32_t> consistent;
+    for (int run = 0; run != 5; ++run) {
+        Clock::time_point start = Clock::now();
+        consistent = index.passend(hits, misses);
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("fleet filter (all)", best, index.anzahl());
+    errors += !std::binary_search(consistent.begin(), consistent.end(), target);
+
+    for (int k = 0; k != 10; ++k) {
+        int r = field(rng) / 10, c = field(rng) % 10;
+        if (all[target].test(r, c))
+            hits = hits | flotten::Flotte::feld(r, c);
+        else
+            misses = misses | flotten::Flotte::feld(r, c);
+    }
+    best = 1e300;
+    std::vector<uint32_t> narrowed;
+    for (int run = 0; run != 5; ++run) {
+        Clock::time_point start = Clock::now();
+        narrowed = index.passend(consistent, hits, misses);
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("fleet filter (narrowing)", best, consistent.size());
+    errors += !std::binary_search(narrowed.begin(), narrowed.end(), target)
+              || narrowed != index.passend(hits, misses);
+    return errors;
+}
+
+/** Places the fleets on empty boards; returns a checksum of the boards */
+template <typename Board>
+long bench_place(const std::string &name, const std::vector<Fleet> &fleets)
+{
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        std::vector<Board> boards(fleets.size());
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i != boards.size(); ++i) {
+            for (int ship = 0; ship != 4; ++ship)
+                boards[i].place(fleets[i].r[ship], fleets[i].c[ship], 4,
+                                fleets[i].down[ship]);
+        }
+        best = std::min(best, elapsed_ns(start));
+
+        checksum = 0;
+        for (size_t i = 0; i != boards.size(); ++i) {
+            for (int field = 0; field != 100; ++field)
+                checksum += field * (boards[i].board(field / 10, field % 10) == 'S');
+        }
+    }
+    report(name, best, 4 * fleets.size());
+    return checksum;
+}
+
+/**
+ * Shoots at nothing but the ships, so that every shot has to find out whether
+ * the ship was sunk (what _has_alive_ship did in the char board).
+ */
+template <typename Board>
+long bench_hits(const std::string &name, const std::vector<Fleet> &fleets)
+{
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        std::vector<Board> boards(fleets.size());
+        for (size_t i = 0; i != fleets.size(); ++i) {
+            for (int ship = 0; ship != 4; ++ship)
+                boards[i].place(fleets[i].r[ship], fleets[i].c[ship], 4,
+                                fleets[i].down[ship]);
+        }
+
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i != boards.size(); ++i) {
+            const Fleet &fleet = fleets[i];
+            for (int ship = 0; ship != 4; ++ship) {
+                for (int k = 0; k != 4; ++k) {
+                    checksum += boards[i].incoming(
+                                    fleet.r[ship] + k * fleet.down[ship],
+                                    fleet.c[ship] + k * !fleet.down[ship]);
+                }
+            }
+        }
+        best = std::min(best, elapsed_ns(start));
+    }
+    report(name, best, 16 * fleets.size());
+    return checksum;
+}
+
+/** Every board is shot at all 100 fields in a random order */
+template <typename Board>
+long bench_shots(const std::string &name, const std::vector<Fleet> &fleets,
+                 const std::vector<int> &order)
+{
+    // Shot sequence, repeated so that each board can start elsewhere
+    std::vector<int> rows, cols;
+    for (int rep = 0; rep != 2; ++rep) {
+        for (size_t k = 0; k != order.size(); ++k) {
+            rows.push_back(order[k] / 10);
+            cols.push_back(order[k] % 10);
+        }
+    }
+
+    // The machine may be busy otherwise: the fastest of a few runs counts
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        std::vector<Board> boards(fleets.size());
+        for (size_t i = 0; i != fleets.size(); ++i) {
+            for (int ship = 0; ship != 4; ++ship)
+                boards[i].place(fleets[i].r[ship], fleets[i].c[ship], 4,
+                                fleets[i].down[ship]);
+        }
+
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i != boards.size(); ++i) {
+            const int *r = &rows[i % 100], *c = &cols[i % 100];
+            for (int shot = 0; shot != 100; ++shot) {
+                checksum += boards[i].incoming(r[shot], c[shot]);
+                checksum += boards[i].alive();
+            }
+        }
+        best = std::min(best, elapsed_ns(start));
+    }
+    report(name, best, 100 * fleets.size());
+    return checksum;
+}
+
+/**
+ * A thread streams shots through a pipe, in writes of a few dozen lines like
+ * a buffered bot, while the reader takes them apart line by line.
+ */
+template <typename Reader>
+long bench_lines(const std::string &name, long nlines)
+{
+    std::string chunk;
+    for (int k = 0; k != 64; ++k) {
+        chunk += char('0' + k % 10);
+        chunk += ' ';
+        chunk += char('0' + k / 10 % 10);
+        chunk += '\n';
+    }
+
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        Pipe pipe = Pipe::open();
+        std::thread writer([&pipe, &chunk, nlines]() {
+            for (long sent = 0; sent < nlines; sent += 64) {
+                for (size_t done = 0; done != chunk.size(); )
+                    done += pipe.write(chunk.data() + done, chunk.size() - done);
+            }
+        });
+
+        Reader reader;
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (long i = 0; i != nlines; ++i) {
+            auto line = reader.getline(pipe, 200, 2000);
+            LineView view(line);
+            checksum += view.size + view.data[0];
+        }
+        best = std::min(best, elapsed_ns(start));
+        writer.join();
+    }
+    report(name, best, nlines);
+    return checksum;
+}
+
+/**
+ * Random lines of digits, signs, white space and junk, terminated by a
+ * newline like the lines of a bot.  (Without it, istringstream rejects lines
+ * ending in a number, which LineScanner deliberately accepts.)
+ */
+std::vector<std::string> random_lines(std::mt19937 &rng, int count)
+{
+    static const char alphabet[] = "0123456789 0123456789 \t\r\v+-RUxR\0";
+    std::uniform_int_distribution<int> length(0, 14), letter(0, 35);
+    std::uniform_int_distribution<int> extra(0, 9);
+
+    std::vector<std::string> lines;
+    for (int k = 0; k != count; ++k) {
+        std::string line;
+        for (int n = length(rng); n != 0; --n)
+            line += alphabet[letter(rng)];
+        // Now and then, numbers near the limits of int
+        if (extra(rng) == 0)
+            line.insert(0, extra(rng) < 5 ? "2147483648 " : "-2147483648 ");
+        lines.push_back(line + '\n');
+    }
+    return lines;
+}
+
+/** Returns the number of lines where the two parsers disagree */
+long fuzz_parsers(const std::vector<std::string> &lines)
+{
+    long mismatches = 0;
+    for (size_t k = 0; k != lines.size(); ++k) {
+        LineView line(lines[k]);
+        int i1 = 0, j1 = 0, i2 = 0, j2 = 0;
+        char c1 = 0, c2 = 0;
+        bool ok1 = LegacyParser::placement(line, i1, j1, c1);
+        bool ok2 = ScannerParser::placement(line, i2, j2, c2);
+        if (ok1 != ok2 || (ok1 && (i1 != i2 || j1 != j2 || c1 != c2)))
+            ++mismatches;
+
+        ok1 = LegacyParser::shot(line, i1, j1);
+        ok2 = ScannerParser::shot(line, i2, j2);
+        if (ok1 != ok2 || (ok1 && (i1 != i2 || j1 != j2)))
+            ++mismatches;
+    }
+    return mismatches;
+}
+
+/** Parses typical bot lines, alternately placements and shots */
+template <typename Parser>
+long bench_parser(const std::string &name, const std::vector<std::string> &lines)
+{
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (size_t k = 0; k != lines.size(); ++k) {
+            int i = 0, j = 0;
+            char c = 0;
+            LineView line(lines[k]);
+            if (k % 2 ? Parser::shot(line, i, j)
+                      : Parser::placement(line, i, j, c))
+                checksum += 10 * i + j;
+        }
+        best = std::min(best, elapsed_ns(start));
+    }
+    report(name, best, lines.size());
+    return checksum;
+}
+
+/** Games of random shots at random fleets, as logged by the referee */
+std::vector<GameRecord> random_records(std::mt19937 &rng,
+                                       const std::vector<Fleet> &fleets)
+{
+    std::uniform_int_distribution<int> coord(0, 9);
+    std::vector<GameRecord> records(fleets.size());
+    GameLog log;
+    for (size_t i = 0; i != fleets.size(); ++i) {
+        Player players[2] = {Player('A'), Player('B')};
+        log.clear();
+        for (int which = 0; which != 2; ++which) {
+            const Fleet &fleet = fleets[(i + which) % fleets.size()];
+            for (int ship = 0; ship != 4; ++ship) {
+                players[which].place(fleet.r[ship], fleet.c[ship], 4,
+                                     fleet.down[ship]);
+                log.placement(players[which].which(), fleet.r[ship],
+                              fleet.c[ship], fleet.down[ship]);
+            }
+        }
+        for (int shot = 0; shot != 200; ++shot) {
+            int r = coord(rng), c = coord(rng);
+            log.shot("AB"[shot % 2], r, c, players[1 - shot % 2].incoming(r, c));
+        }
+        log.fill(records[i], i % 2 ? "./gerade" : "./ungerade", "./andere",
+                 i % 3);
+    }
+    return records;
+}
+
+/** Appends records to a file, then scans and replays them from the map */
+long bench_records(const std::vector<GameRecord> &records)
+{
+    char path[] = "/tmp/benchmark_XXXXXX";
+    int fd = checked(mkstemp(path));
+    ::close(fd);
+
+    double best_write = 1e300, best_scan = 1e300, best_replay = 1e300;
+    long checksum = 0;
+    for (int run = 0; run != 5; ++run) {
+        truncate(path, 0);
+        Clock::time_point start = Clock::now();
+        {
+            RecordWriter writer(path);
+            for (size_t i = 0; i != records.size(); ++i)
+                writer.append(records[i]);
+        }
+        best_write = std::min(best_write, elapsed_ns(start));
+
+        RecordReader reader(path);
+        checksum = 0;
+        start = Clock::now();
+        for (size_t i = 0; i != reader.size(); ++i)
+            checksum += reader[i].valid() && reader[i].plays("./gerade");
+        best_scan = std::min(best_scan, elapsed_ns(start));
+
+        std::ostream quiet(nullptr);
+        start = Clock::now();
+        for (size_t i = 0; i != reader.size(); ++i)
+            checksum += replay_game(reader[i], quiet);
+        best_replay = std::min(best_replay, elapsed_ns(start));
+    }
+    unlink(path);
+    report("record append", best_write, records.size());
+    report("record scan (mmap)", best_scan, records.size());
+    report("record replay", best_replay, records.size());
+    return checksum;
+}
+
+/**
+ * Rebuilds the ratings of 20 programs from `count` recorded games, going
+ * through `records` again and again with random players and results.
+ * Returns whether Elo stayed zero-sum and every game was counted.
+ */
+bool bench_ratings(std::vector<GameRecord> records, std::mt19937 &rng,
+                   long count)
+{
+    enum { PROGRAMS = 20 };
+
+    std::uniform_int_distribution<int> program(0, PROGRAMS - 1), result(0, 2);
+    for (size_t i = 0; i != records.size(); ++i) {
+        int a = program(rng), b = (a + 1 + program(rng) % (PROGRAMS - 1))
+                                  % PROGRAMS;
+        memset(records[i].spec, 0, sizeof(records[i].spec));
+        snprintf(records[i].spec[0], GameRecord::SPEC_SIZE, "./ki_%02d", a);
+        snprintf(records[i].spec[1], GameRecord::SPEC_SIZE, "./ki_%02d", b);
+        records[i].result = result(rng);
+    }
+
+    Ratings ratings;
+    Clock::time_point start = Clock::now();
+    for (long i = 0; i != count; ++i)
+        ratings.add(records[i % records.size()]);
+    report("ratings (rebuild)", elapsed_ns(start), count);
+
+    double elo = 0;
+    long games = 0;
+    for (size_t i = 0; i != ratings.size(); ++i) {
+        elo += ratings[i].elo;
+        games += ratings[i].games;
+    }
+    return ratings.size() == PROGRAMS && games == 2 * count
+           && std::abs(elo - PROGRAMS * Ratings::INITIAL_ELO) < 1e-6;
+}
+
+/**
+ * Whole games of a bot against itself, as in a tournament, in variant
+ * `Rules`.  Returns a checksum of the results, or -1 if a player failed.
+ */
+template <typename Rules = Standard>
+long bench_transport(const std::string &name, const std::string &spec,
+                     int games)
+{
+    static const char result_a[] = {'U', 'W', 'L'};
+    static const char result_b[] = {'U', 'L', 'W'};
+
+    SessionPool sessions;
+    std::ostream quiet(nullptr);
+    long checksum = 0;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        checksum = 0;
+        Clock::time_point start = Clock::now();
+        for (int game = 0; game != games; ++game) {
+            BasicPlayer<Rules> player_a = sessions.start<Rules>('A', spec);
+            BasicPlayer<Rules> player_b = sessions.start<Rules>('B', spec);
+            int result = play_game(player_a, player_b, quiet);
+            if (player_a.failed() || player_b.failed())
+                return -1;
+            if (player_a.conclude(result_a[result]))
+                sessions.release(spec, player_a.release_child());
+            if (player_b.conclude(result_b[result]))
+                sessions.release(spec, player_b.release_child());
+            checksum += result + player_a.live() + player_b.live();
+        }
+        best = std::min(best, elapsed_ns(start));
+    }
+    report(name, best, games);
+    return checksum;
+}
+
+/**
+ * Times round trips to ./plugin_ki: the referee sends a result, the program
+ * answers with its next shot, `count` times in all.  With `shared` the
+ * program plays through shared memory instead of its pipes.  Returns a
+ * checksum of the shots, or -1 if the transport was not the one asked for.
+ */
+long bench_round_trip(const std::string &name, bool shared, long count)
+{
+    enum { SHOTS = 90 };        // per game, before plugin_ki runs out
+
+    ChildProcess::shared_memory() = shared;
+    ChildProcess child("./plugin_ki");
+    ChildProcess::shared_memory() = false;
+
+    LatencyHistogram trips;
+    long checksum = 0;
+    double total = 0;
+    for (long done = 0; done < count; ) {
+        // placement and the first shot, after the greeting in the first game
+        if (child.getline() == "MULTI\n")
+            child.getline();
+        for (int line = 0; line != 4; ++line)
+            child.getline();
+        for (int shot = 0; shot != SHOTS && done != count; ++shot, ++done) {
+            Clock::time_point start = Clock::now();
+            child.send("F\n");
+            LineView line = child.getline();
+            double ns = elapsed_ns(start);
+            trips.record(int64_t(ns));
+            total += ns;
+            checksum = 31 * checksum + std::hash<std::string>()(line.str());
+        }
+        child.send("U\nN\n");
+    }
+    report(name, total, count);
+    report(name + " p99", trips.quantile(0.99), 1);
+    return child.uses_shared_memory() == shared ? std::abs(checksum) : -1;
+}
+
+/**
+ * Lets the plugin `path` shoot at the fleets until they are sunk, timing
+ * every decision.  Returns the number of shots it needed.
+ */
+long bench_ai(const std::string &name, const std::string &path,
+              const std::vector<Fleet> &fleets, size_t games)
+{
+    static const char outcome_char[] = {'F', 'T', 'V'};
+
+    const PluginLibrary &library = PluginLibrary::load(path);
+    LatencyHistogram decisions;
+    long shots = 0;
+    double total = 0;
+    for (size_t i = 0; i != games && i != fleets.size(); ++i) {
+        Player board;
+        for (int ship = 0; ship != 4; ++ship)
+            board.place(fleets[i].r[ship], fleets[i].c[ship], 4,
+                        fleets[i].down[ship]);
+
+        spieler_spiel *game = library.start();
+        for (int shot = 0; shot != 100 && board.alive(); ++shot) {
+            int r, c;
+            Clock::time_point start = Clock::now();
+            library.shoot(game, &r, &c);
+            double ns = elapsed_ns(start);
+            decisions.record(int64_t(ns));
+            total += ns;
+            ++shots;
+            library.outcome(game, outcome_char[board.incoming(r, c)]);
+        }
+        library.end(game);
+    }
+    report(name, total, shots);
+    report(name + " p99", decisions.quantile(0.99), 1);
+    return shots;
+}
+
+/** Starts a program as the referee did up to version 1.1 */
+struct ForkedProcess
+{
+    ForkedProcess(const char *path) : pid(fork()) {
+        if (pid == 0) {
+            int null = open("/dev/null", O_RDWR);
+            dup2(null, STDIN_FILENO);
+            dup2(null, STDOUT_FILENO);
+            execl(path, path, NULL);
+            _exit(47);
+        }
+    }
+
+    ~ForkedProcess() {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+    }
+
+    pid_t pid;
+};
+
+/** Runs ./bot_server on a socket in /tmp while it exists */
+struct BotServer
+{
+    BotServer() : path("/tmp/benchmark_" + std::to_string(getpid()) + ".sock"),
+                  pid(fork()) {
+        if (pid == 0) {
+            int null = open("/dev/null", O_RDWR);
+            dup2(null, STDIN_FILENO);
+            dup2(null, STDERR_FILENO);
+            execl("./bot_server", "./bot_server", path.c_str(), NULL);
+            _exit(47);
+        }
+    }
+
+    ~BotServer() {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        unlink(path.c_str());
+    }
+
+    /** Waits up to a second for the server to listen */
+    bool ready() const {
+        for (int attempt = 0; attempt != 100; ++attempt) {
+            try {
+                BotConnection::get(path);
+                return true;
+            } catch(const std::runtime_error &e) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+        return false;
+    }
+
+    std::string path;
+    pid_t pid;
+};
+
+/**
+ * Starts and stops the program `path` while `ballast_mb` of memory are in
+ * use, as in a long tournament.  fork() copies the page tables of all of
+ * it, posix_spawn() does not.
+ */
+template <typename Process>
+void bench_spawn(const std::string &name, const char *path, int ballast_mb)
+{
+    std::vector<char> ballast(size_t(ballast_mb) << 20, 1);
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i != 50; ++i)
+            Process process(path);
+        best = std::min(best, elapsed_ns(start));
+    }
+    report(name, best, 50);
+}
+
+/** Reading the resource usage of a running process, as after every game */
+long bench_usage(int count)
+{
+    long checksum = 0;
+    Clock::time_point start = Clock::now();
+    for (int i = 0; i != count; ++i)
+        checksum += ResourceUsage::of_running(getpid()).max_rss_kb;
+    report("usage (/proc)", elapsed_ns(start), count);
+    return checksum;
+}
+
+/**
+ * Registry of children of the referee up to version 1.1: a list guarded by
+ * a mutex.  Kept as a baseline for ChildRegistry.
+ */
+class LegacyRegistry
+{
+public:
+    typedef std::list<pid_t>::iterator Entry;
+
+    Entry add(pid_t pid) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _children.push_back(pid);
+        return --_children.end();
+    }
+
+    void remove(Entry entry) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _children.erase(entry);
+    }
+
+private:
+    std::mutex _mutex;
+    std::list<pid_t> _children;
+};
+
+/** ChildRegistry with the interface of LegacyRegistry */
+struct SlotRegistry
+{
+    typedef int Entry;
+
+    Entry add(pid_t pid) { return ChildRegistry::add(pid); }
+
+    void remove(Entry entry) { ChildRegistry::remove(entry); }
+};
+
+/**
+ * Registers and removes `pid` from `nthreads` threads at once, keeping 16
+ * entries per thread, as many threads starting and stopping bots would.
+ */
+template <typename Registry>
+void bench_registry(const std::string &name, pid_t pid, int nthreads)
+{
+    enum { ROUNDS = 20000, LIVE = 16 };
+
+    Registry registry;
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t != nthreads; ++t) {
+        threads.push_back(std::thread([&registry, pid] {
+            typename Registry::Entry entries[LIVE];
+            for (int round = 0; round != ROUNDS; ++round) {
+                for (int k = 0; k != LIVE; ++k)
+                    entries[k] = registry.add(pid);
+                for (int k = 0; k != LIVE; ++k)
+                    registry.remove(entries[k]);
+            }
+        }));
+    }
+    for (size_t t = 0; t != threads.size(); ++t)
+        threads[t].join();
+    report(name, elapsed_ns(start), long(nthreads) * ROUNDS * LIVE);
+}
+
+/**
+ * Starts and stops `count` programs on each of `nthreads` threads while
+ * another thread keeps killing all registered children, as the signal
+ * handler would.  Returns the number of problems: children left in the
+ * registry or not reaped.
+ */
+long stress_children(int nthreads, int count)
+{
+    std::atomic<bool> done(false);
+    std::thread killer([&done] {
+        while (!done) {
+            ChildRegistry::kill_all();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t != nthreads; ++t) {
+        threads.push_back(std::thread([count] {
+            for (int i = 0; i != count; ++i) {
+                ChildProcess child("./plugin_ki");
+                try {
+                    child.getline();            // "MULTI", unless killed
+                } catch(const std::runtime_error &e) {
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t != threads.size(); ++t)
+        threads[t].join();
+    report("spawn+kill (" + std::to_string(nthreads) + " threads)",
+           elapsed_ns(start), long(nthreads) * count);
+    done = true;
+    killer.join();
+
+    long problems = ChildRegistry::size();
+    if (waitpid(-1, NULL, WNOHANG) != -1 || errno != ECHILD)
+        ++problems;
+    return problems;
+}
+
+/**
+ * Counts `count` games on each of `nthreads` threads, each as a worker of
+ * its own or all as the same worker, which makes them share cache lines.
+ * Returns whether all games were counted.
+ */
+bool bench_metrics(const std::string &name, int nthreads, long count,
+                   bool shared)
+{
+    std::vector<std::string> specs;
+    specs.push_back("./a");
+    specs.push_back("./b");
+    SessionPool sessions;
+    Metrics metrics(specs, nthreads, sessions);
+    GameLog log;
+
+    std::vector<std::thread> threads;
+    Clock::time_point start = Clock::now();
+    for (int t = 0; t != nthreads; ++t) {
+        threads.push_back(std::thread([&, t] {
+            for (long i = 0; i != count; ++i) {
+                metrics.started(shared ? 0 : t);
+                metrics.finished(shared ? 0 : t, specs[0], specs[1], log);
+            }
+        }));
+    }
+    for (size_t t = 0; t != threads.size(); ++t)
+        threads[t].join();
+    report(name, elapsed_ns(start), nthreads * count);
+
+    std::ostringstream out;
+    metrics.write(out);
+    std::ostringstream expected;
+    expected << "schiffe_versenken_spiele_total " << nthreads * count << "\n";
+    return out.str().find(expected.str()) != std::string::npos;
+}
+
+/** Whole tournaments of `specs`, with all the starting of processes */
+size_t bench_tournament(const std::string &name,
+                        const std::vector<std::string> &specs,
+                        int games_per_pairing, bool events, int prestarted=0)
+{
+    size_t games = 0;
+    double best = 1e300;
+    for (int run = 0; run != 3; ++run) {
+        Tournament tournament(specs, games_per_pairing, false);
+        if (prestarted)
+            tournament.prestart(prestarted);
+        Clock::time_point start = Clock::now();
+        if (events)
+            tournament.run_events(64);
+        else
+            tournament.run(std::thread::hardware_concurrency());
+        best = std::min(best, elapsed_ns(start));
+        games = tournament.num_games();
+    }
+    report(name, best, games);
+    return games;
+}
+
+/**
+ * Plays a tournament of ./test_ki, which plays one game per process, and
+ * ./plugin_ki, which plays several.  Returns the number of games that did
+ * not end with a fleet sunk, as when a single-game process is reused.
+ */
+long check_single_game_bots(bool events, int prestarted=0)
+{
+    std::vector<std::string> specs;
+    specs.push_back("./test_ki");
+    specs.push_back("./plugin_ki");
+    Tournament tournament(specs, 20, false);
+    std::ostringstream games;
+    tournament.log_games(games);
+    if (prestarted)
+        tournament.prestart(prestarted);
+    if (events)
+        tournament.run_events(64);
+    else
+        tournament.run(std::thread::hardware_concurrency());
+
+    long wrong = tournament.num_games();
+    std::istringstream lines(games.str());
+    for (std::string line; std::getline(lines, line); )
+        wrong -= line.find("\"grund\":\"versenkt\"") != std::string::npos;
+    return wrong;
+}
+
+/**
+ * Records log-normally distributed latencies; returns the number of
+ * quantiles that are further than 1/16 from the exact ones.
+ */
+long bench_histogram(std::mt19937 &rng, int count)
+{
+    std::lognormal_distribution<double> latency(10.0, 2.0);
+    std::vector<uint64_t> values(count);
+    for (int i = 0; i != count; ++i)
+        values[i] = uint64_t(latency(rng));
+
+    LatencyHistogram histogram;
+    double best = 1e300;
+    for (int run = 0; run != 5; ++run) {
+        histogram.clear();
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i != count; ++i)
+            histogram.record(values[i]);
+        best = std::min(best, elapsed_ns(start));
+    }
+    report("latency record", best, count);
+
+    std::sort(values.begin(), values.end());
+    long wrong = histogram.max() != values.back();
+    const double quantiles[] = {0.5, 0.9, 0.99, 0.999};
+    for (int k = 0; k != 4; ++k) {
+        double exact = values[size_t(quantiles[k] * count + 0.999999) - 1];
+        double estimate = histogram.quantile(quantiles[k]);
+        wrong += std::abs(estimate - exact) > exact / 16;
+    }
+    return wrong;
+}
+
+/** Groups of benchmarks given on the command line; empty for all */
+std::set<std::string> selected_groups;
+
+bool wanted(const char *group)
+{
+    return selected_groups.empty() || selected_groups.count(group) != 0;
+}
+
+int main(int argc, char *argv[])
+{
+    for (int i = 1; i != argc; ++i) {
+        if (std::string(argv[i]) == "--json")
+            json_output = true;
+        else
+            selected_groups.insert(argv[i]);
+    }
+
+    // As in tournaments: a program that went away must not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    std::mt19937 rng(4711);
+    std::vector<Fleet> fleets = random_fleets(rng, 20000);
+    std::vector<int> order(100);
+    for (int i = 0; i != 100; ++i)
+        order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    if (wanted("board")) {
+        long legacy = bench_place<LegacyBoard>("place (char[][])", fleets);
+        long masks = bench_place<Player>("place (BoardMask)", fleets);
+        legacy -= bench_hits<LegacyBoard>("incoming hits (char[][])", fleets);
+        masks -= bench_hits<Player>("incoming hits (BoardMask)", fleets);
+        legacy += bench_shots<LegacyBoard>("incoming+alive (char[][])",
+                                           fleets, order);
+        masks += bench_shots<Player>("incoming+alive (BoardMask)",
+                                     fleets, order);
+        if (legacy != masks) {
+            std::cerr << "FEHLER: Ergebnisse der Spielfelder unterscheiden sich\n";
+            return 1;
+        }
+    }
+
+    if (wanted("fleet")) {
+        long errors = bench_fleets(rng, fleets);
+        if (errors != 0) {
+            std::cerr << "FEHLER: " << errors << " Fehler im Flottenindex\n";
+            return 1;
+        }
+    }
+
+    if (wanted("getline")) {
+        long legacy_lines = bench_lines<LegacyLineReader>(
+                                    "getline (std::string)", 1 << 20);
+        long view_lines = bench_lines<LineBuffer>("getline (LineBuffer)",
+                                                  1 << 20);
+        if (legacy_lines != view_lines) {
+            std::cerr << "FEHLER: Ergebnisse der Zeilenleser unterscheiden sich\n";
+            return 1;
+        }
+    }
+
+    if (wanted("parse")) {
+        long mismatches = fuzz_parsers(random_lines(rng, 1000000));
+        if (mismatches != 0) {
+            std::cerr << "FEHLER: Parser unterscheiden sich bei " << mismatches
+                      << " Zeilen\n";
+            return 1;
+        }
+
+        std::vector<std::string> moves;
+        for (int k = 0; k != 200000; ++k) {
+            std::string move = std::to_string(k % 10) + ' '
+                               + std::to_string(k / 10 % 10);
+            moves.push_back(move + (k % 2 ? "\n" : " R\n"));
+        }
+        long legacy_moves = bench_parser<LegacyParser>("parse (istringstream)",
+                                                       moves);
+        long scanned_moves = bench_parser<ScannerParser>("parse (LineScanner)",
+                                                         moves);
+        if (legacy_moves != scanned_moves) {
+            std::cerr << "FEHLER: Ergebnisse der Parser unterscheiden sich\n";
+            return 1;
+        }
+    }
+
+    if (wanted("record")) {
+        std::vector<GameRecord> records = random_records(rng, fleets);
+        if (bench_records(records) != long(records.size() + records.size() / 2)) {
+            std::cerr << "FEHLER: Aufzeichnungen wurden falsch gelesen\n";
+            return 1;
+        }
+        if (!bench_ratings(records, rng, 500000)) {
+            std::cerr << "FEHLER: Wertungen sind falsch\n";
+            return 1;
+        }
+    }
+
+    if (wanted("game")) {
+        long piped = bench_transport("game (pipe)", "./plugin_ki", 200);
+        long plugged = bench_transport("game (plugin)", "lib:./plugin_ki.so",
+                                       200);
+        if (piped != plugged) {
+            std::cerr << "FEHLER: Plugin und Programm spielen verschieden\n";
+            return 1;
+        }
+        bench_transport("game (test_ki, pipe)", "./test_ki", 200);
+
+        std::vector<std::string> specs;
+        specs.push_back("./test_ki");
+        specs.push_back("./plugin_ki");
+        specs.push_back("lib:./plugin_ki.so");
+        bench_tournament("tournament (threads)", specs, 100, false);
+        bench_tournament("tournament (vorstart)", specs, 100, false, 2);
+        bench_tournament("tournament (epoll)", specs, 100, true);
+
+        // programs that do not say MULTI get a process per game
+        long wrong = check_single_game_bots(false)
+                     + check_single_game_bots(false, 2)
+                     + check_single_game_bots(true);
+        if (wrong != 0) {
+            std::cerr << "FEHLER: " << wrong << " Turnierspiele mit "
+                         "./test_ki enden nicht regulaer\n";
+            return 1;
+        }
+
+        BotServer server;
+        if (!server.ready()) {
+            std::cerr << "FEHLER: ./bot_server startet nicht\n";
+            return 1;
+        }
+        long served = bench_transport("game (socket)", "unix:" + server.path,
+                                      200);
+        if (served != piped) {
+            std::cerr << "FEHLER: Bot-Server und Programm spielen "
+                         "verschieden\n";
+            return 1;
+        }
+        specs[1] = "unix:" + server.path;
+        bench_tournament("tournament (socket)", specs, 100, false);
+
+        ChildProcess::shared_memory() = true;
+        long shared = bench_transport("game (shm)", "./plugin_ki", 200);
+        ChildProcess::shared_memory() = false;
+        if (shared != piped) {
+            std::cerr << "FEHLER: ueber gemeinsamen Speicher wird anders "
+                         "gespielt\n";
+            return 1;
+        }
+
+        // The variant reaches the bots on every way
+        ChildProcess::variant() = GameVariant::of<Mixed>();
+        long variant[] = {
+            bench_transport<Mixed>("game (gemischt, pipe)", "./plugin_ki",
+                                   100),
+            bench_transport<Mixed>("game (gemischt, plugin)",
+                                   "lib:./plugin_ki.so", 100),
+            bench_transport<Mixed>("game (gemischt, socket)",
+                                   "unix:" + server.path, 100)
+        };
+        ChildProcess::variant() = GameVariant();
+        if (variant[0] < 0 || variant[1] != variant[0]
+                || variant[2] != variant[0]) {
+            std::cerr << "FEHLER: Variante wird nicht oder verschieden "
+                         "gespielt\n";
+            return 1;
+        }
+    }
+
+    if (wanted("spawn")) {
+        bench_spawn<ForkedProcess>("spawn (fork, 16 MB)", "./plugin_ki", 16);
+        bench_spawn<ChildProcess>("spawn (posix_spawn, 16 MB)", "./plugin_ki",
+                                  16);
+        bench_spawn<ForkedProcess>("spawn (fork, 256 MB)", "./plugin_ki", 256);
+        bench_spawn<ChildProcess>("spawn (posix_spawn, 256 MB)",
+                                  "./plugin_ki", 256);
+        if (bench_usage(10000) <= 0) {
+            std::cerr << "FEHLER: Speicherverbrauch nicht lesbar\n";
+            return 1;
+        }
+    }
+
+    if (wanted("metrics")) {
+        int nthreads = std::max(4u, std::thread::hardware_concurrency());
+        bool counted = bench_metrics("metrics (shared worker)", nthreads,
+                                     1000000, true);
+        counted &= bench_metrics("metrics (per worker)", nthreads, 1000000,
+                                 false);
+        if (!counted) {
+            std::cerr << "FEHLER: Metriken haben Spiele verloren\n";
+            return 1;
+        }
+    }
+
+    if (wanted("registry")) {
+        {
+            // Whatever a stray kill_all() hits, it is only this program
+            ChildProcess target("./plugin_ki");
+            int nthreads = std::max(4u, std::thread::hardware_concurrency());
+            bench_registry<LegacyRegistry>("registry (mutex+list)",
+                                           target.child_pid(), nthreads);
+            bench_registry<SlotRegistry>("registry (atomic slots)",
+                                         target.child_pid(), nthreads);
+        }
+        long problems = stress_children(8, 100);
+        if (problems != 0) {
+            std::cerr << "FEHLER: " << problems << " Kindprozesse nicht "
+                         "aufgeraeumt\n";
+            return 1;
+        }
+    }
+
+    if (wanted("ai")) {
+        long reference = bench_ai("shot (referenz_ki)", "./referenz_ki.so",
+                                  fleets, 500);
+        long example = bench_ai("shot (plugin_ki)", "./plugin_ki.so",
+                                fleets, 500);
+        if (reference >= example) {
+            std::cerr << "FEHLER: referenz_ki braucht mehr Schuesse ("
+                      << reference << ") als plugin_ki (" << example << ")\n";
+            return 1;
+        }
+    }
+
+    if (wanted("latency")) {
+        if (bench_histogram(rng, 1000000) != 0) {
+            std::cerr << "FEHLER: Quantile des Histogramms sind ungenau\n";
+            return 1;
+        }
+        long piped = bench_round_trip("round trip (pipe)", false, 20000);
+        long shared = bench_round_trip("round trip (shm)", true, 20000);
+        if (piped < 0 || shared < 0) {
+            std::cerr << "FEHLER: falscher Weg fuer die Zeilen\n";
+            return 1;
+        }
+        if (piped != shared) {
+            std::cerr << "FEHLER: Schuesse ueber gemeinsamen Speicher und "
+                         "Pipe unterscheiden sich\n";
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Bot-Server fuer "Schiffe versenken": spielt beliebig viele Spiele
+ * gleichzeitig ueber einen Unix-Domain-Socket, statt fuer jedes Spiel als
+ * eigenes Programm gestartet zu werden.  Das lohnt sich fuer Spieler, die
+ * lange brauchen, um z.B. grosse Tabellen zu laden.
+ *
+ *     ./bot_server /tmp/ki.sock &
+ *     ./schiffe_versenken --turnier unix:/tmp/ki.sock ./andere_ki
+ *
+ * Der Schiedsrichter verbindet sich einmal und schickt die Zeilen aller
+ * Spiele ueber diese eine Verbindung.  Jede Zeile beginnt mit der Nummer
+ * ihres Spiels, sonst sind es die Zeilen des normalen Protokolls:
+ *
+ *     17 N            Spiel 17 beginnt
+ *     17 3 4 R        (Antwort) Schiffe und Schuesse von Spiel 17
+ *     17 F            Ergebnis eines Schusses, dann 'W', 'L' oder 'U'
+ *     17 ENDE         Spiel 17 ist vorbei, auch ohne Ergebnis
+ *
+ * Spiele einer Variante beginnen mit Zeilen, Spalten und den Laengen der
+ * Schiffe, z.B. "17 N 10 10 5 4 3 3 2".  Kann das Plugin sie nicht spielen
+ * (spieler_neu_variante() fehlt oder gibt NULL zurueck), bleibt das Spiel
+ * ohne Antwort.
+ *
+ * Gespielt wird mit einem Spieler-Plugin (siehe spieler_plugin.h), das
+ * dazugelinkt wird, so wie bei spieler_programm.cpp:
+ *
+ *     g++ -o bot_server bot_server.cpp meine_ki.cpp
+ */
+#include "spieler_plugin.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Plugins ohne Varianten definieren die Funktion nicht: dann ist sie NULL
+#pragma weak spieler_neu_variante
+
+/** Eine Verbindung zum Schiedsrichter mit ihren laufenden Spielen */
+struct Verbindung {
+    int fd;
+    string eingabe;                         // noch unvollstaendige Zeile
+    map<unsigned long, spieler_spiel *> spiele;
+};
+
+/** Schreibt alles oder gibt false zurueck */
+static bool schreiben(int fd, const string &text)
+{
+    size_t fertig = 0;
+    while (fertig != text.size()) {
+        ssize_t n = write(fd, text.data() + fertig, text.size() - fertig);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        fertig += n;
+    }
+    return true;
+}
+
+/** Haengt den naechsten Schuss von Spiel `nummer` an `antwort` an */
+static void schiessen(unsigned long nummer, spieler_spiel *spiel,
+                      string &antwort)
+{
+    int zeile, spalte;
+    spieler_schiessen(spiel, &zeile, &spalte);
+    antwort += to_string(nummer) + " " + to_string(zeile) + " "
+               + to_string(spalte) + "\n";
+}
+
+/**
+ * Beginnt ein Spiel, im Standardspiel auf "N", in einer Variante auf
+ * "N ZEILEN SPALTEN LAENGE..."; `anzahl` wird die Anzahl der Schiffe
+ */
+static spieler_spiel *beginnen(const string &befehl, int &anzahl)
+{
+    anzahl = 4;
+    if (befehl == "N")
+        return spieler_neu();
+    istringstream zahlen(befehl.substr(1));
+    int zeilen, spalten;
+    vector<int> laengen;
+    zahlen >> zeilen >> spalten;
+    for (int laenge; zahlen >> laenge; )
+        laengen.push_back(laenge);
+    if (!zahlen.eof() || laengen.empty() || !spieler_neu_variante)
+        return nullptr;
+    anzahl = laengen.size();
+    return spieler_neu_variante(zeilen, spalten, anzahl, laengen.data());
+}
+
+/** Bearbeitet eine Zeile (ohne Zeilenumbruch) und sammelt die Antworten */
+static void bearbeiten(Verbindung &v, const string &zeile, string &antwort)
+{
+    char *rest;
+    unsigned long nummer = strtoul(zeile.c_str(), &rest, 10);
+    if (*rest != ' ')
+        return;
+    string befehl(rest + 1);
+
+    map<unsigned long, spieler_spiel *>::iterator it = v.spiele.find(nummer);
+    if (befehl == "N" || befehl.compare(0, 2, "N ") == 0) {
+        int anzahl;
+        spieler_spiel *spiel = beginnen(befehl, anzahl);
+        if (!spiel)
+            return;                         // der Schiedsrichter wartet umsonst
+        v.spiele[nummer] = spiel;
+        for (int schiff = 0; schiff != anzahl; ++schiff) {
+            int z, s;
+            char richtung;
+            spieler_setzen(spiel, schiff, &z, &s, &richtung);
+            antwort += to_string(nummer) + " " + to_string(z) + " "
+                       + to_string(s) + " " + richtung + "\n";
+        }
+        schiessen(nummer, spiel, antwort);
+    } else if (it == v.spiele.end()) {
+        return;                             // Spiel ist schon vorbei
+    } else if (befehl == "ENDE") {
+        spieler_ende(it->second);
+        v.spiele.erase(it);
+    } else if (befehl.size() == 1 && strchr("FTV", befehl[0])) {
+        spieler_ergebnis(it->second, befehl[0]);
+        schiessen(nummer, it->second, antwort);
+    } else if (befehl.size() == 1 && strchr("WLU", befehl[0])) {
+        spieler_ergebnis(it->second, befehl[0]);
+    }
+    // Andere Zeilen, z.B. die Restzeit "Z ...", braucht dieses Plugin nicht
+}
+
+/** Liest, was der Schiedsrichter geschickt hat; false wenn er fertig ist */
+static bool lesen(Verbindung &v)
+{
+    char puffer[4096];
+    ssize_t n = read(v.fd, puffer, sizeof(puffer));
+    if (n < 0 && errno == EINTR)
+        return true;
+    if (n <= 0)
+        return false;
+
+    v.eingabe.append(puffer, n);
+    string antwort;
+    size_t anfang = 0, ende;
+    while ((ende = v.eingabe.find('\n', anfang)) != string::npos) {
+        bearbeiten(v, v.eingabe.substr(anfang, ende - anfang), antwort);
+        anfang = ende + 1;
+    }
+    v.eingabe.erase(0, anfang);
+    return schreiben(v.fd, antwort);
+}
+
+static void schliessen(Verbindung &v)
+{
+    map<unsigned long, spieler_spiel *>::iterator it;
+    for (it = v.spiele.begin(); it != v.spiele.end(); ++it)
+        spieler_ende(it->second);
+    close(v.fd);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        cerr << "Verwendung: " << argv[0] << " SOCKET\n";
+        return 2;
+    }
+
+    sockaddr_un adresse;
+    memset(&adresse, 0, sizeof(adresse));
+    adresse.sun_family = AF_UNIX;
+    if (strlen(argv[1]) >= sizeof(adresse.sun_path)) {
+        cerr << "FEHLER: Pfad ist zu lang\n";
+        return 1;
+    }
+    strcpy(adresse.sun_path, argv[1]);
+
+    // Ein Schiedsrichter, der abbricht, soll den Server nicht beenden
+    signal(SIGPIPE, SIG_IGN);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(argv[1]);
+    if (server < 0
+        || bind(server, (sockaddr *)&adresse, sizeof(adresse)) != 0
+        || listen(server, 16) != 0) {
+        cerr << "FEHLER: " << argv[1] << ": " << strerror(errno) << "\n";
+        return 1;
+    }
+    cerr << "Bot-Server wartet auf " << argv[1] << "\n";
+
+    vector<Verbindung> verbindungen;
+    for (;;) {
+        vector<pollfd> warten(1 + verbindungen.size());
+        warten[0].fd = server;
+        warten[0].events = POLLIN;
+        for (size_t i = 0; i != verbindungen.size(); ++i) {
+            warten[i + 1].fd = verbindungen[i].fd;
+            warten[i + 1].events = POLLIN;
+        }
+        if (poll(warten.data(), warten.size(), -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            cerr << "FEHLER: " << strerror(errno) << "\n";
+            return 1;
+        }
+
+        // Von hinten, damit das Entfernen die Nummern davor nicht verschiebt
+        for (size_t i = verbindungen.size(); i-- != 0; ) {
+            if (warten[i + 1].revents == 0 || lesen(verbindungen[i]))
+                continue;
+            schliessen(verbindungen[i]);
+            verbindungen.erase(verbindungen.begin() + i);
+        }
+        if (warten[0].revents & POLLIN) {
+            int fd = accept(server, NULL, NULL);
+            if (fd >= 0) {
+                Verbindung v;
+                v.fd = fd;
+                verbindungen.push_back(v);
+            }
+        }
+    }
+}
@@ -0,0 +1,26 @@
+/*
+ * Erzeugt den Index aller erlaubten Flotten (siehe flotten_index.h):
+ *
+ *     ./flotten_index DATEI
+ */
+#include "flotten_index.h"
+
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2) {
+        std::cerr << "Verwendung: " << argv[0] << " DATEI\n";
+        return 2;
+    }
+    try {
+        std::vector<flotten::Flotte> flotten = flotten::FlottenIndex::aufzaehlen();
+        flotten::FlottenIndex::schreiben(argv[1], flotten);
+        std::cerr << flotten.size() << " Flotten nach '" << argv[1]
+                  << "' geschrieben\n";
+    } catch(const std::runtime_error &e) {
+        std::cerr << "FEHLER: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/*
+ * Index aller erlaubten Flotten von "Schiffe versenken".
+ *
+ * Eine Flotte aus vier Schiffen der Laenge 4, die sich nicht beruehren, ist
+ * eine Bitmaske mit einem Bit je Feld (Bit 10*zeile+spalte).  Aus der Maske
+ * ergeben sich die Schiffe eindeutig, da sich Schiffe nicht beruehren.  Der
+ * Index enthaelt alle 2 326 895 Flotten, aufsteigend sortiert, und kann als
+ * Datei abgelegt und mit mmap() geladen werden:
+ *
+ *     ./flotten_index flotten.idx
+ *
+ *     flotten::FlottenIndex index("flotten.idx");
+ *     flotten::Flotte f = index.zufaellig(zufall);         // gleichverteilt
+ *     std::vector<uint32_t> moeglich = index.passend(treffer, fehlschuesse);
+ *
+ * Ohne Datei zaehlt FlottenIndex() die Flotten selbst auf, was aber etwa
+ * eine halbe Sekunde dauert.
+ */
+#ifndef FLOTTEN_INDEX_H
+#define FLOTTEN_INDEX_H
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace flotten {
+
+/** Menge von Feldern, z.B. eine Flotte oder die Treffer */
+struct Flotte {
+    uint64_t lo, hi;
+
+    static Flotte feld(int zeile, int spalte) {
+        int i = 10 * zeile + spalte;
+        Flotte f = {0, 0};
+        if (i < 64)
+            f.lo = uint64_t(1) << i;
+        else
+            f.hi = uint64_t(1) << (i - 64);
+        return f;
+    }
+
+    bool test(int zeile, int spalte) const {
+        Flotte f = feld(zeile, spalte);
+        return ((lo & f.lo) | (hi & f.hi)) != 0;
+    }
+
+    Flotte operator|(const Flotte &f) const {
+        Flotte r = {lo | f.lo, hi | f.hi};
+        return r;
+    }
+
+    bool operator==(const Flotte &f) const { return lo == f.lo && hi == f.hi; }
+
+    bool operator<(const Flotte &f) const {
+        return hi < f.hi || (hi == f.hi && lo < f.lo);
+    }
+};
+
+/** Kopf der Datei; danach folgen `anzahl` Flotten */
+struct Kopf {
+    char magie[4];              // "SVF1"
+    uint32_t groesse;           // sizeof(Flotte)
+    uint64_t anzahl;
+};
+
+class FlottenIndex
+{
+public:
+    /** So viele erlaubte Flotten gibt es */
+    static const size_t ANZAHL = 2326895;
+
+    /** Zaehlt alle Flotten auf */
+    FlottenIndex() : _flotten(aufzaehlen()), _daten(&_flotten[0]),
+                     _anzahl(_flotten.size()), _abbild(nullptr),
+                     _abbild_groesse(0) { }
+
+    /** Laedt einen mit schreiben() erzeugten Index */
+    explicit FlottenIndex(const std::string &datei)
+        : _daten(nullptr), _anzahl(0), _abbild(nullptr), _abbild_groesse(0)
+    {
+        int fd = open(datei.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error(
+                    "Kann '" + datei + "' nicht oeffnen: " + strerror(errno));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(Kopf))) {
+            close(fd);
+            throw std::runtime_error("'" + datei + "' ist kein Flottenindex");
+        }
+        _abbild_groesse = info.st_size;
+        _abbild = mmap(nullptr, _abbild_groesse, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (_abbild == MAP_FAILED) {
+            throw std::runtime_error(
+                    "Kann '" + datei + "' nicht laden: " + strerror(errno));
+        }
+
+        const Kopf *kopf = static_cast<const Kopf *>(_abbild);
+        if (memcmp(kopf->magie, "SVF1", 4) != 0
+            || kopf->groesse != sizeof(Flotte)
+            || kopf->anzahl != (_abbild_groesse - sizeof(Kopf)) / sizeof(Flotte)) {
+            munmap(_abbild, _abbild_groesse);
+            throw std::runtime_error("'" + datei + "' ist kein Flottenindex");
+        }
+        _daten = reinterpret_cast<const Flotte *>(kopf + 1);
+        _anzahl = kopf->anzahl;
+    }
+
+    ~FlottenIndex() {
+        if (_abbild)
+            munmap(_abbild, _abbild_groesse);
+    }
+
+    size_t anzahl() const { return _anzahl; }
+
+    const Flotte &operator[](size_t i) const { return _daten[i]; }
+
+    /** Eine gleichverteilt zufaellige Flotte */
+    template <typename Zufall>
+    const Flotte &zufaellig(Zufall &zufall) const {
+        std::uniform_int_distribution<size_t> index(0, _anzahl - 1);
+        return _daten[index(zufall)];
+    }
+
+    /** Ob `flotte` eine erlaubte Flotte ist */
+    bool enthaelt(const Flotte &flotte) const {
+        const Flotte *ende = _daten + _anzahl;
+        const Flotte *gefunden = std::lower_bound(_daten, ende, flotte);
+        return gefunden != ende && *gefunden == flotte;
+    }
+
+    /** Indizes der Flotten, die alle `treffer` und keine `fehlschuesse` belegen */
+    std::vector<uint32_t> passend(const Flotte &treffer,
+                                  const Flotte &fehlschuesse) const {
+        std::vector<uint32_t> ergebnis;
+        for (size_t i = 0; i != _anzahl; ++i) {
+            if (_passt(_daten[i], treffer, fehlschuesse))
+                ergebnis.push_back(i);
+        }
+        return ergebnis;
+    }
+
+    /**
+     * Wie oben, aber nur unter den Flotten `auswahl`; so wird die Menge der
+     * moeglichen Flotten im Laufe eines Spiels immer schneller kleiner.
+     */
+    std::vector<uint32_t> passend(const std::vector<uint32_t> &auswahl,
+                                  const Flotte &treffer,
+                                  const Flotte &fehlschuesse) const {
+        std::vector<uint32_t> ergebnis;
+        for (size_t k = 0; k != auswahl.size(); ++k) {
+            if (_passt(_daten[auswahl[k]], treffer, fehlschuesse))
+                ergebnis.push_back(auswahl[k]);
+        }
+        return ergebnis;
+    }
+
+    /** Alle erlaubten Flotten, sortiert */
+    static std::vector<Flotte> aufzaehlen() {
+        // Lage eines Schiffs und die Felder, die es fuer andere sperrt
+        std::vector<Flotte> schiff, sperre;
+        for (int unten = 0; unten != 2; ++unten) {
+            for (int z = 0; z != (unten ? 7 : 10); ++z) {
+                for (int s = 0; s != (unten ? 10 : 7); ++s) {
+                    Flotte m = {0, 0}, h = {0, 0};
+                    for (int k = 0; k != 4; ++k) {
+                        int zk = z + k * unten, sk = s + k * !unten;
+                        m = m | Flotte::feld(zk, sk);
+                        h = h | Flotte::feld(zk, sk);
+                        if (zk > 0) h = h | Flotte::feld(zk - 1, sk);
+                        if (zk < 9) h = h | Flotte::feld(zk + 1, sk);
+                        if (sk > 0) h = h | Flotte::feld(zk, sk - 1);
+                        if (sk < 9) h = h | Flotte::feld(zk, sk + 1);
+                    }
+                    schiff.push_back(m);
+                    sperre.push_back(h);
+                }
+            }
+        }
+
+        std::vector<Flotte> flotten;
+        flotten.reserve(ANZAHL);
+        size_t n = schiff.size();
+        for (size_t a = 0; a != n; ++a) {
+            for (size_t b = a + 1; b != n; ++b) {
+                Flotte ab = sperre[a] | sperre[b];
+                if (_beruehrt(schiff[b], sperre[a]))
+                    continue;
+                for (size_t c = b + 1; c != n; ++c) {
+                    if (_beruehrt(schiff[c], ab))
+                        continue;
+                    Flotte abc = ab | sperre[c];
+                    Flotte drei = schiff[a] | schiff[b] | schiff[c];
+                    for (size_t d = c + 1; d != n; ++d) {
+                        if (!_beruehrt(schiff[d], abc))
+                            flotten.push_back(drei | schiff[d]);
+                    }
+                }
+            }
+        }
+        std::sort(flotten.begin(), flotten.end());
+        return flotten;
+    }
+
+    /** Schreibt die Flotten als Index nach `datei` */
+    static void schreiben(const std::string &datei,
+                          const std::vector<Flotte> &flotten) {
+        Kopf kopf;
+        memcpy(kopf.magie, "SVF1", 4);
+        kopf.groesse = sizeof(Flotte);
+        kopf.anzahl = flotten.size();
+
+        int fd = open(datei.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                      0644);
+        if (fd < 0) {
+            throw std::runtime_error(
+                    "Kann '" + datei + "' nicht anlegen: " + strerror(errno));
+        }
+        bool ok = _alles_schreiben(fd, &kopf, sizeof(kopf))
+                  && _alles_schreiben(fd, flotten.data(),
+                                      flotten.size() * sizeof(Flotte));
+        if (close(fd) != 0 || !ok) {
+            throw std::runtime_error(
+                    "Kann '" + datei + "' nicht schreiben: " + strerror(errno));
+        }
+    }
+
+private:
+    FlottenIndex(const FlottenIndex &) = delete;
+    FlottenIndex &operator=(const FlottenIndex &) = delete;
+
+    static bool _beruehrt(const Flotte &a, const Flotte &b) {
+        return ((a.lo & b.lo) | (a.hi & b.hi)) != 0;
+    }
+
+    static bool _passt(const Flotte &f, const Flotte &treffer,
+                       const Flotte &fehlschuesse) {
+        // ohne Verzweigungen, damit der Compiler die Schleifen vektorisiert
+        return (((f.lo & fehlschuesse.lo) | (f.hi & fehlschuesse.hi))
+                | ((f.lo & treffer.lo) ^ treffer.lo)
+                | ((f.hi & treffer.hi) ^ treffer.hi)) == 0;
+    }
+
+    static bool _alles_schreiben(int fd, const void *daten, size_t groesse) {
+        const char *zeiger = static_cast<const char *>(daten);
+        while (groesse > 0) {
+            ssize_t n = write(fd, zeiger, groesse);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                return false;
+            zeiger += n;
+            groesse -= n;
+        }
+        return true;
+    }
+
+    std::vector<Flotte> _flotten;
+    const Flotte *_daten;
+    size_t _anzahl;
+    void *_abbild;
+    size_t _abbild_groesse;
+};
+
+}
+
+#endif /* FLOTTEN_INDEX_H */
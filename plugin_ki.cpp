@@ -0,0 +1,110 @@
+/*
+ * Beispiel fuer ein Spieler-Plugin (siehe spieler_plugin.h): schiesst im
+ * Schachbrettmuster, bis es trifft, und danach auf die Nachbarfelder.
+ * Spielt auch Varianten mit bis zu 15 x 15 Feldern.
+ *
+ * Als Plugin:            g++ -shared -fPIC -o plugin_ki.so plugin_ki.cpp
+ * Als Spieler-Programm:  g++ -o plugin_ki plugin_ki.cpp spieler_programm.cpp
+ */
+#include "spieler_plugin.h"
+
+#include <vector>
+
+struct spieler_spiel {
+    int zeilen, spalten;
+    bool standard;
+    bool beschossen[15][15];
+    std::vector<int> ziele;         // Felder neben Treffern, als spalten*z+s
+    int naechstes;                  // im Schachbrettmuster
+    int zeile, spalte;              // letzter Schuss
+};
+
+int spieler_version(void)
+{
+    return SPIELER_PLUGIN_VERSION;
+}
+
+spieler_spiel *spieler_neu(void)
+{
+    spieler_spiel *spiel = new spieler_spiel();
+    spiel->zeilen = spiel->spalten = 10;
+    spiel->standard = true;
+    spiel->naechstes = 0;
+    return spiel;
+}
+
+spieler_spiel *spieler_neu_variante(int zeilen, int spalten, int anzahl,
+                                    const int *laengen)
+{
+    // Jedes Schiff bekommt eine eigene Zeile, mit einer leeren dazwischen
+    if (zeilen > 15 || spalten > 15 || 2 * anzahl - 1 > zeilen)
+        return nullptr;
+    for (int schiff = 0; schiff != anzahl; ++schiff) {
+        if (laengen[schiff] > spalten)
+            return nullptr;
+    }
+    spieler_spiel *spiel = spieler_neu();
+    spiel->zeilen = zeilen;
+    spiel->spalten = spalten;
+    spiel->standard = false;
+    return spiel;
+}
+
+void spieler_setzen(spieler_spiel *spiel, int schiff,
+                    int *zeile, int *spalte, char *richtung)
+{
+    static const int z[] = {0, 2, 4, 6}, s[] = {0, 2, 4, 6};
+    static const char r[] = {'R', 'U', 'U', 'R'};
+    if (!spiel->standard) {
+        *zeile = 2 * schiff;
+        *spalte = 0;
+        *richtung = 'R';
+        return;
+    }
+    *zeile = z[schiff];
+    *spalte = s[schiff];
+    *richtung = r[schiff];
+}
+
+void spieler_schiessen(spieler_spiel *spiel, int *zeile, int *spalte)
+{
+    int felder = spiel->zeilen * spiel->spalten;
+    int feld = -1;
+    while (!spiel->ziele.empty() && feld < 0) {
+        int ziel = spiel->ziele.back();
+        spiel->ziele.pop_back();
+        if (!spiel->beschossen[ziel / spiel->spalten][ziel % spiel->spalten])
+            feld = ziel;
+    }
+    // Erst jedes zweite Feld, dann die uebrigen
+    while (feld < 0 && spiel->naechstes < 2 * felder) {
+        int k = spiel->naechstes++;
+        int z = k % felder / spiel->spalten, s = k % spiel->spalten;
+        if ((z + s) % 2 == k / felder && !spiel->beschossen[z][s])
+            feld = spiel->spalten * z + s;
+    }
+    if (feld < 0)
+        feld = 0;
+
+    spiel->zeile = *zeile = feld / spiel->spalten;
+    spiel->spalte = *spalte = feld % spiel->spalten;
+    spiel->beschossen[*zeile][*spalte] = true;
+}
+
+void spieler_ergebnis(spieler_spiel *spiel, char ergebnis)
+{
+    if (ergebnis == 'T') {
+        int z = spiel->zeile, s = spiel->spalte, n = spiel->spalten;
+        if (z > 0) spiel->ziele.push_back(n * (z - 1) + s);
+        if (z < spiel->zeilen - 1) spiel->ziele.push_back(n * (z + 1) + s);
+        if (s > 0) spiel->ziele.push_back(n * z + s - 1);
+        if (s < n - 1) spiel->ziele.push_back(n * z + s + 1);
+    } else if (ergebnis == 'V') {
+        spiel->ziele.clear();
+    }
+}
+
+void spieler_ende(spieler_spiel *spiel)
+{
+    delete spiel;
+}
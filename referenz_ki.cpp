@@ -0,0 +1,346 @@
+/*
+ * Referenz-KI fuer "Schiffe versenken" (als Plugin, siehe spieler_plugin.h):
+ * schiesst auf das Feld, das in den meisten noch moeglichen Aufstellungen der
+ * uebrigen Schiffe belegt ist.
+ *
+ * Jede der 140 Lagen eines Schiffs ist eine Bitmaske mit einem Bit je Feld;
+ * ob zwei Lagen sich ueberlappen oder beruehren, ist damit ein einziges UND.
+ * Solange es nicht zu viele sind, werden alle Aufstellungen der uebrigen
+ * Schiffe aufgezaehlt, die zu den bisherigen Treffern und Fehlschuessen
+ * passen.  Sonst (vor allem am Anfang) zaehlt jedes Schiff fuer sich.
+ *
+ * Als Plugin:            g++ -O2 -shared -fPIC -o referenz_ki.so referenz_ki.cpp
+ * Als Spieler-Programm:  g++ -O2 -o referenz_ki referenz_ki.cpp spieler_programm.cpp
+ */
+#include "spieler_plugin.h"
+
+#include <random>
+#include <stdint.h>
+
+namespace {
+
+/** Menge von Feldern, Bit 10*zeile+spalte */
+struct Maske {
+    uint64_t lo, hi;
+
+    bool leer() const { return (lo | hi) == 0; }
+
+    bool enthaelt(int feld) const {
+        return (feld < 64 ? lo >> feld : hi >> (feld - 64)) & 1;
+    }
+
+    bool trifft(const Maske &m) const { return ((lo & m.lo) | (hi & m.hi)) != 0; }
+
+    int anzahl() const {
+        return __builtin_popcountll(lo) + __builtin_popcountll(hi);
+    }
+
+    /** Kleinstes Feld der Menge */
+    int erstes() const {
+        return lo ? __builtin_ctzll(lo) : 64 + __builtin_ctzll(hi);
+    }
+
+    void setzen(int feld) {
+        if (feld < 64)
+            lo |= uint64_t(1) << feld;
+        else
+            hi |= uint64_t(1) << (feld - 64);
+    }
+
+    Maske operator|(const Maske &m) const { Maske r = {lo | m.lo, hi | m.hi}; return r; }
+    Maske operator&(const Maske &m) const { Maske r = {lo & m.lo, hi & m.hi}; return r; }
+    Maske ohne(const Maske &m) const { Maske r = {lo & ~m.lo, hi & ~m.hi}; return r; }
+};
+
+const int LAGEN = 140;
+
+/** Menge von Lagen, Bit l fuer Lage l */
+struct Satz {
+    uint64_t w[3];
+
+    bool leer() const { return (w[0] | w[1] | w[2]) == 0; }
+
+    bool enthaelt(int l) const { return (w[l >> 6] >> (l & 63)) & 1; }
+
+    void setzen(int l) { w[l >> 6] |= uint64_t(1) << (l & 63); }
+
+    int anzahl() const {
+        return __builtin_popcountll(w[0]) + __builtin_popcountll(w[1])
+               + __builtin_popcountll(w[2]);
+    }
+
+    Satz operator&(const Satz &s) const {
+        Satz r = {{w[0] & s.w[0], w[1] & s.w[1], w[2] & s.w[2]}};
+        return r;
+    }
+
+    Satz ohne(const Satz &s) const {
+        Satz r = {{w[0] & ~s.w[0], w[1] & ~s.w[1], w[2] & ~s.w[2]}};
+        return r;
+    }
+
+    /** Ruft f(l) fuer jede Lage l auf, aufsteigend */
+    template <typename F>
+    void fuer_alle(F f) const {
+        for (int i = 0; i != 3; ++i) {
+            for (uint64_t bits = w[i]; bits; bits &= bits - 1)
+                f(64 * i + __builtin_ctzll(bits));
+        }
+    }
+};
+
+/** Alle Lagen eines Schiffs, mit allem, was sich daraus vorberechnen laesst */
+struct Lagen {
+    Maske schiff[LAGEN];
+    Maske sperre[LAGEN];     // Schiff und seine Nachbarn (nicht diagonal)
+    int feld[LAGEN][4];
+    Satz konflikt[LAGEN];    // Lagen, die l ueberlappen oder beruehren
+    Satz hoeher[LAGEN];      // Lagen nach l
+    Satz auf_feld[100];      // Lagen, die das Feld belegen
+
+    Lagen() {
+        int n = 0;
+        for (int unten = 0; unten != 2; ++unten) {
+            for (int z = 0; z != (unten ? 7 : 10); ++z) {
+                for (int s = 0; s != (unten ? 10 : 7); ++s, ++n) {
+                    Maske m = {0, 0}, h = {0, 0};
+                    for (int k = 0; k != 4; ++k) {
+                        int zk = z + k * unten, sk = s + k * !unten;
+                        feld[n][k] = 10 * zk + sk;
+                        m.setzen(10 * zk + sk);
+                        h.setzen(10 * zk + sk);
+                        if (zk > 0) h.setzen(10 * (zk - 1) + sk);
+                        if (zk < 9) h.setzen(10 * (zk + 1) + sk);
+                        if (sk > 0) h.setzen(10 * zk + sk - 1);
+                        if (sk < 9) h.setzen(10 * zk + sk + 1);
+                    }
+                    schiff[n] = m;
+                    sperre[n] = h;
+                }
+            }
+        }
+
+        Satz keine = {{0, 0, 0}};
+        for (int f = 0; f != 100; ++f)
+            auf_feld[f] = keine;
+        for (int l = 0; l != LAGEN; ++l) {
+            konflikt[l] = hoeher[l] = keine;
+            for (int q = 0; q != LAGEN; ++q) {
+                if (schiff[q].trifft(sperre[l]))
+                    konflikt[l].setzen(q);
+                if (q > l)
+                    hoeher[l].setzen(q);
+            }
+            for (int k = 0; k != 4; ++k)
+                auf_feld[feld[l][k]].setzen(l);
+        }
+    }
+};
+
+const Lagen &lagen()
+{
+    static const Lagen alle;
+    return alle;
+}
+
+/** Wie viele Schritte die Aufzaehlung hoechstens machen darf */
+const long BUDGET = 1L << 12;
+
+/** Zustand einer Aufzaehlung aller passenden Aufstellungen */
+struct Suche {
+    Maske treffer;              // getroffen, aber noch nicht versenkt
+    Satz passt;                 // Lagen, die alle Treffer in ihrer Naehe erklaeren
+    uint64_t zaehler[LAGEN];    // Aufstellungen, in denen die Lage vorkommt
+    int gewaehlt[4];
+    long budget;
+
+    /**
+     * Zaehlt die Aufstellungen von `rest` weiteren Schiffen in den Lagen
+     * `frei`.  Schiffe auf Treffern werden in der Reihenfolge der Treffer
+     * gewaehlt, die uebrigen in der Reihenfolge ihrer Lagen, so dass jede
+     * Aufstellung genau einmal vorkommt.  Gibt false zurueck, wenn das
+     * Budget nicht reicht.
+     */
+    bool zaehlen(const Satz &frei, const Maske &belegt, int rest, int tiefe) {
+        const Lagen &alle = lagen();
+        Maske offen = treffer.ohne(belegt);
+        if (--budget < 0)
+            return false;
+
+        if (!offen.leer()) {
+            if (rest == 0 || offen.anzahl() > 4 * rest)
+                return true;
+            Satz kandidaten = frei & passt & alle.auf_feld[offen.erstes()];
+            for (int i = 0; i != 3; ++i) {
+                for (uint64_t bits = kandidaten.w[i]; bits; bits &= bits - 1) {
+                    int l = 64 * i + __builtin_ctzll(bits);
+                    gewaehlt[tiefe] = l;
+                    if (!zaehlen(frei.ohne(alle.konflikt[l]),
+                                 belegt | alle.schiff[l], rest - 1, tiefe + 1))
+                        return false;
+                }
+            }
+            return true;
+        }
+
+        if (rest == 0) {
+            for (int t = 0; t != tiefe; ++t)
+                ++zaehler[gewaehlt[t]];
+            return true;
+        }
+        if (rest == 1) {
+            // Das letzte Schiff passt in jede Lage, die noch frei ist
+            uint64_t *z = zaehler;
+            frei.fuer_alle([z](int l) { ++z[l]; });
+            uint64_t n = frei.anzahl();
+            for (int t = 0; t != tiefe; ++t)
+                zaehler[gewaehlt[t]] += n;
+            budget -= n / 8;
+            return true;
+        }
+        for (int i = 0; i != 3; ++i) {
+            for (uint64_t bits = frei.w[i]; bits; bits &= bits - 1) {
+                int l = 64 * i + __builtin_ctzll(bits);
+                gewaehlt[tiefe] = l;
+                Satz rest_frei = frei.ohne(alle.konflikt[l]) & alle.hoeher[l];
+                if (!zaehlen(rest_frei, belegt | alle.schiff[l], rest - 1,
+                             tiefe + 1))
+                    return false;
+            }
+        }
+        return true;
+    }
+};
+
+}
+
+struct spieler_spiel {
+    std::mt19937 zufall;
+    Maske beschossen;           // alle Schuesse
+    Maske treffer;              // Treffer auf noch nicht versenkte Schiffe
+    Maske gesperrt;             // Fehlschuesse und versenkte Schiffe mit Nachbarn
+    int versenkt;
+    int flotte[4];              // eigene Schiffe, als Index in lagen()
+    int letzter;                // letzter Schuss, als 10*zeile+spalte
+};
+
+int spieler_version(void)
+{
+    return SPIELER_PLUGIN_VERSION;
+}
+
+spieler_spiel *spieler_neu(void)
+{
+    spieler_spiel *spiel = new spieler_spiel();
+    spiel->zufall.seed(std::random_device()());
+    return spiel;
+}
+
+void spieler_setzen(spieler_spiel *spiel, int schiff,
+                    int *zeile, int *spalte, char *richtung)
+{
+    const Lagen &alle = lagen();
+    if (schiff == 0) {
+        // Zufaellige Flotte; sitzen die ersten Schiffe ungluecklich, von vorn
+        std::uniform_int_distribution<int> lage(0, LAGEN - 1);
+        int n = 0;
+        for (int versuch = 0; n != 4; ++versuch) {
+            if (versuch % 1000 == 0)
+                n = 0;
+            int l = lage(spiel->zufall);
+            bool frei = true;
+            for (int k = 0; k != n; ++k)
+                frei = frei && !alle.schiff[l].trifft(alle.sperre[spiel->flotte[k]]);
+            if (frei)
+                spiel->flotte[n++] = l;
+        }
+    }
+    int l = spiel->flotte[schiff];
+    *zeile = alle.feld[l][0] / 10;
+    *spalte = alle.feld[l][0] % 10;
+    *richtung = alle.feld[l][1] - alle.feld[l][0] == 10 ? 'U' : 'R';
+}
+
+void spieler_schiessen(spieler_spiel *spiel, int *zeile, int *spalte)
+{
+    const Lagen &alle = lagen();
+    Satz frei = {{0, 0, 0}};
+    Suche suche;
+    suche.treffer = spiel->treffer;
+    suche.passt = frei;
+    suche.budget = BUDGET;
+    for (int l = 0; l != LAGEN; ++l) {
+        if (!alle.schiff[l].trifft(spiel->gesperrt))
+            frei.setzen(l);
+        if (!alle.sperre[l].ohne(alle.schiff[l]).trifft(spiel->treffer))
+            suche.passt.setzen(l);
+        suche.zaehler[l] = 0;
+    }
+
+    Maske nichts = {0, 0};
+    if (!suche.zaehlen(frei, nichts, 4 - spiel->versenkt, 0)) {
+        // Zu viele Aufstellungen: jedes Schiff fuer sich, Treffer zuerst
+        for (int l = 0; l != LAGEN; ++l) {
+            if (!frei.enthaelt(l))
+                suche.zaehler[l] = 0;
+            else if (spiel->treffer.leer())
+                suche.zaehler[l] = 1;
+            else if (suche.passt.enthaelt(l))
+                suche.zaehler[l] = (alle.schiff[l] & spiel->treffer).anzahl();
+            else
+                suche.zaehler[l] = 0;
+        }
+    }
+
+    uint64_t dichte[100] = {0};
+    for (int l = 0; l != LAGEN; ++l) {
+        for (int k = 0; k != 4; ++k)
+            dichte[alle.feld[l][k]] += suche.zaehler[l];
+    }
+    int feld = -1;
+    for (int f = 0; f != 100; ++f) {
+        if (spiel->beschossen.enthaelt(f))
+            continue;
+        if (feld < 0 || dichte[f] > dichte[feld])
+            feld = f;
+    }
+    if (feld < 0)
+        feld = 0;
+
+    spiel->letzter = feld;
+    spiel->beschossen.setzen(feld);
+    *zeile = feld / 10;
+    *spalte = feld % 10;
+}
+
+void spieler_ergebnis(spieler_spiel *spiel, char ergebnis)
+{
+    int feld = spiel->letzter;
+    Maske schuss = {0, 0};
+    schuss.setzen(feld);
+    if (ergebnis == 'F') {
+        spiel->gesperrt = spiel->gesperrt | schuss;
+    } else if (ergebnis == 'T') {
+        spiel->treffer = spiel->treffer | schuss;
+    } else if (ergebnis == 'V') {
+        // Schiffe beruehren sich nicht: das versenkte sind die Treffer, die
+        // in einer Reihe am letzten Schuss haengen
+        spiel->treffer = spiel->treffer | schuss;
+        const Lagen &alle = lagen();
+        for (int l = 0; l != LAGEN; ++l) {
+            Maske m = alle.schiff[l];
+            if (m.enthaelt(feld) && m.ohne(spiel->treffer).leer()
+                && !alle.sperre[l].ohne(m).trifft(spiel->treffer)) {
+                spiel->gesperrt = spiel->gesperrt | alle.sperre[l];
+                spiel->treffer = spiel->treffer.ohne(m);
+                break;
+            }
+        }
+        ++spiel->versenkt;
+    }
+}
+
+void spieler_ende(spieler_spiel *spiel)
+{
+    delete spiel;
+}
@@ -7,33 +7,61 @@
  *
  * Kompilieren Sie das Programm wie folgt:
  *
- *     g++ -std=c++11 -o schiffe_versenken schiffe_versenken.cpp
+ *     g++ -std=c++11 -pthread -o schiffe_versenken schiffe_versenken.cpp -ldl
  *
  * Autor: Markus Wallerberger
  */
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
 #include <iostream>
-#include <list>
+#include <map>
 #include <memory>
 #include <mutex>
 #include <set>
-#include <sstream>
 #include <stdexcept>
+#include <thread>
+#include <type_traits>
 #include <vector>
 #include <iomanip>
+#include <cmath>
+
+#include "spieler_plugin.h"
+#include "spieler_shm.h"
 
 // C and POSIX headers
 #include <stdlib.h>
+#include <dlfcn.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <poll.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
 #include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 
-static const std::string VERSION = "1.1";
+extern char **environ;
+
+/**
+ * Version of the referee.  It keys the results kept with --ergebnisse (see
+ * ResultCache), so every change to how games are played, e.g. to the
+ * protocol, time limits or rules, must bump it.
+ */
+static const std::string VERSION = "2.0";
 
 template <typename T> T checked(T errcode)
 {
@@ -49,67 +77,84 @@ template <typename T> T monitored(T errcode)
     return errcode;
 }
 
-template <typename T>
-class Registered
+/** Nanoseconds on a clock that never jumps; never 0 */
+inline uint64_t monotonic_ns()
 {
-public:
-    Registered() : _this_reg(publish(static_cast<T *>(this))) { }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-    Registered(const Registered &other) : Registered() { }
+/**
+ * Process ids of all running children, so that a signal handler can kill
+ * them.  Every child claims a slot of a fixed table with a compare-and-swap
+ * and frees it with a plain store, so spawning from many threads needs no
+ * lock, and kill_all() only reads the table and calls kill(), both of which
+ * are async-signal-safe.
+ */
+class ChildRegistry
+{
+public:
+    enum { SLOTS = 1 << 14 };
 
-    Registered &operator=(const Registered &other) { return *this; }
+    /** Registers `pid`; returns its slot, or -1 if the table is full */
+    static int add(pid_t pid) {
+        // Start where the last search left off, so that the table is
+        // scanned round-robin instead of always from the front
+        unsigned start = _next().fetch_add(1, std::memory_order_relaxed);
+        for (unsigned k = 0; k != SLOTS; ++k) {
+            unsigned slot = (start + k) % SLOTS;
+            pid_t expected = 0;
+            if (_slots()[slot].compare_exchange_strong(expected, pid))
+                return slot;
+        }
+        return -1;
+    }
 
-    ~Registered() { retract(_this_reg); }
+    static void remove(int slot) {
+        if (slot >= 0)
+            _slots()[slot].store(0);
+    }
 
-    static void cleanup() {
-        std::list<T *> &registry = get_registry();
-        std::mutex &mutex = registry_mutex();
+    /** Number of registered children */
+    static size_t size() {
+        size_t count = 0;
+        for (unsigned slot = 0; slot != SLOTS; ++slot)
+            count += _slots()[slot].load() != 0;
+        return count;
+    }
 
-        T *current;
-        size_t ncleaned;
-        for (ncleaned = 0; ; ++ncleaned) {
-            {
-                // Note that ~T() unregisters itself: we thus do not need to do
-                // that here, but we do have to avoid deadlocks to the mutex.
-                std::lock_guard<std::mutex> lock(mutex);
-                if (registry.empty())
-                    break;
-                current = registry.front();
+    /**
+     * Sends SIGKILL to all registered children and returns how many there
+     * were.  Async-signal-safe.  A child is removed only after it has been
+     * killed and before it is reaped, so its pid cannot have been reused.
+     */
+    static size_t kill_all() {
+        size_t count = 0;
+        for (unsigned slot = 0; slot != SLOTS; ++slot) {
+            pid_t pid = _slots()[slot].load();
+            if (pid > 0) {
+                kill(pid, SIGKILL);
+                ++count;
             }
-            current->~T();
-        }
-        if (ncleaned) {
-            std::cerr << "Cleaned " << ncleaned << " objects\n";
         }
+        return count;
     }
 
 private:
-    static std::list<T *> &get_registry() {
-        static std::list<T *> registry;           // thread-safe
-        return registry;
-    }
+    static_assert(ATOMIC_INT_LOCK_FREE == 2,
+                  "ChildRegistry needs lock-free atomics");
 
-    static std::mutex &registry_mutex() {
-        static std::mutex mutex;
-        return mutex;
-    }
-
-    static typename std::list<T *>::iterator publish(T *obj) {
-        std::list<T *> &registry = get_registry();
-        std::lock_guard<std::mutex> lock(registry_mutex());
-        //std::cerr << "[+]";
-        registry.push_back(obj);
-        return --registry.end();
+    // Static storage is zeroed before any code runs, so the table is
+    // ready even for a signal arriving before main()
+    static std::atomic<pid_t> *_slots() {
+        static std::atomic<pid_t> slots[SLOTS];
+        return slots;
     }
 
-    static void retract(typename std::list<T *>::iterator pos) {
-        std::list<T *> &registry = get_registry();
-        std::lock_guard<std::mutex> lock(registry_mutex());
-        //std::cerr << "[-]";
-        registry.erase(pos);
+    static std::atomic<unsigned> &_next() {
+        static std::atomic<unsigned> next(0);
+        return next;
     }
-
-    typename std::list<T *>::iterator _this_reg;
 };
 
 class Pipe
@@ -117,8 +162,17 @@ class Pipe
 public:
     static Pipe open() {
         // pipe[0] <-- pipe[1]
+        // The descriptors are close-on-exec, otherwise children started
+        // concurrently by other threads inherit them and keep the pipe open
+        // after "their" bot is gone.  dup2() in the child clears the flag.
         int fd[2];
+#ifdef __linux__
+        checked(pipe2(fd, O_CLOEXEC));
+#else
         checked(pipe(fd));
+        checked(fcntl(fd[0], F_SETFD, FD_CLOEXEC));
+        checked(fcntl(fd[1], F_SETFD, FD_CLOEXEC));
+#endif
         return Pipe(fd);
     }
 
@@ -204,71 +258,88 @@ private:
     int _fdread, _fdwrite;
 };
 
-class ChildProcess
-    : public Registered<ChildProcess>
+/** A line written by a player, pointing into the buffer it was read into */
+struct LineView
 {
-public:
-    ChildProcess() : _child_pid(-1) { }
+    LineView() : data(""), size(0) { }
 
-    ChildProcess(std::string name)
-        : _to_child(Pipe::open())
-        , _from_child(Pipe::open())
-    {
-            // Then, fork
-        _child_pid = checked(fork());
-        if (_child_pid == 0) {
-            // on child
-            checked(dup2(_to_child.fd_read(), STDIN_FILENO));
-            checked(dup2(_from_child.fd_write(), STDOUT_FILENO));
-            _to_child.close();
-            _from_child.close();
-            execl(name.c_str(), name.c_str(), NULL);
-
-            // This will only be reached if exec fails
-            std::cerr << "\nFEHLER beim Ausführen von `" << name << "': "
-                      << strerror(errno) << std::endl;
-            exit(47);
-        }
+    LineView(const char *data, size_t size) : data(data), size(size) { }
 
-        // on parent
-        _to_child.close_read();
-        _from_child.close_write();
-    }
+    LineView(const std::string &str) : data(str.data()), size(str.size()) { }
 
-    ~ChildProcess() {
-        if (_child_pid >= 0) {
-            monitored(kill(_child_pid, SIGKILL));
-            monitored(waitpid(_child_pid, NULL, 0));
-            _child_pid = -1;
-        }
+    bool empty() const { return size == 0; }
+
+    bool operator==(const char *text) const {
+        return strlen(text) == size && memcmp(data, text, size) == 0;
     }
 
-    // copy-and-swap idiom
-    ChildProcess(ChildProcess &&other) : ChildProcess() { swap(*this, other); }
+    std::string str() const { return std::string(data, size); }
 
-    ChildProcess &operator=(ChildProcess &&other) { swap(*this, other); return *this; }
+    const char *data;
+    size_t size;
+};
 
-    friend void swap(ChildProcess &left, ChildProcess &right) {
-        using std::swap;
-        swap(left._child_pid, right._child_pid);
-        swap(left._from_child, right._from_child);
-        swap(left._to_child, right._to_child);
-    }
+std::ostream &operator<<(std::ostream &out, const LineView &line)
+{
+    return out.write(line.data, line.size);
+}
 
-    bool started() const { return _child_pid >= 0; }
+/**
+ * Fixed-size buffer for the output of a program, which hands out complete
+ * lines as views into its storage instead of copying them.
+ *
+ * New data is read in behind what is buffered, so one read() may deliver
+ * many lines.  Only when the end of the storage is reached, the unfinished
+ * line (if any) wraps around to the front.  Lines are thus contiguous, and a
+ * view stays valid until the buffer reads again.
+ */
+class LineBuffer
+{
+public:
+    enum { CAPACITY = 4096 };
 
-    std::string getline(int maxlen=200, int timeout=2000) const {
-        std::vector<char> buffer(maxlen+1);
-        for(int tries=0; tries != 3; ++tries) {
-            size_t linesize = _buffer.find('\n');
-            if (linesize != std::string::npos) {
-                std::string line = _buffer.substr(0, linesize+1);
-                _buffer = _buffer.substr(linesize+1);
-                return line;
-            }
+    LineBuffer() : _begin(0), _scan(0), _end(0), _eof(false) { }
+
+    /** Takes the next complete line from the buffer, if there is one */
+    bool next_line(LineView &line) {
+        if (_scan == _end)
+            return false;
+        const char *newline = static_cast<const char *>(
+                        memchr(_storage.get() + _scan, '\n', _end - _scan));
+        if (newline == NULL) {
+            _scan = _end;
+            return false;
+        }
+        size_t stop = newline - _storage.get() + 1;
+        line = LineView(_storage.get() + _begin, stop - _begin);
+        _begin = _scan = stop;
+        return true;
+    }
+
+    /**
+     * Like next_line(), but fails if the line grows too long or the program
+     * has closed its output without finishing it.
+     */
+    bool try_getline(LineView &line, int maxlen) {
+        bool complete = next_line(line);
+        if ((complete ? line.size : _end - _begin) > size_t(3 * maxlen)) {
+            throw std::runtime_error(
+                        "Das Spieler-Programm gibt zu lange Zeilen aus");
+        }
+        if (!complete && _eof) {
+            throw std::runtime_error(
+                        "Das Spieler-Programm ist wahrscheinlich abgestürzt "
+                        "oder ist zu frueh fertig.");
+        }
+        return complete;
+    }
 
+    /** Waits up to `timeout` ms at a time until a line is complete */
+    LineView getline(const Pipe &pipe, int maxlen, int timeout) {
+        LineView line;
+        while (!try_getline(line, maxlen)) {
             pollfd poll_info;
-            poll_info.fd = _from_child.fd_read();
+            poll_info.fd = pipe.fd_read();
             poll_info.events = POLLIN;
 
             // The process has not returned any data :(
@@ -277,430 +348,5132 @@ public:
                     "Timeout: das Spieler-Programm hat innerhalb einiger Zeit "
                     "keine Zeile geschrieben");
             }
-
-            int nbytes = _from_child.read(buffer.data(), maxlen);
-            buffer[nbytes] = '\0';
-            _buffer += std::string(buffer.data());
+            fill(pipe);
         }
-        throw std::runtime_error(
-                        "Das Spieler-Programm gibt zu lange Zeilen aus");
+        return line;
     }
 
-    void send(const std::string &input) const {
-        _to_child.write(input.c_str(), input.size());
+    /** Reads what the pipe has to offer, blocking if that is nothing */
+    int fill(const Pipe &pipe) {
+        return fill_with([&pipe](char *buffer, int size) {
+            return pipe.read(buffer, size);
+        });
     }
 
-    const Pipe &to_child() const { return _to_child; }
-
-    const Pipe &from_child() const { return _from_child; }
+    /**
+     * Like fill(), but from any source: `read(buffer, size)` stores up to
+     * `size` bytes and returns their number, 0 at the end of the output.
+     */
+    template <typename Read>
+    int fill_with(Read read) {
+        if (!_storage) {
+            _storage.reset(new char[CAPACITY]);
+        } else if (_begin == _end) {
+            _begin = _scan = _end = 0;
+        } else if (_end == CAPACITY) {
+            memmove(_storage.get(), _storage.get() + _begin, _end - _begin);
+            _scan -= _begin;
+            _end -= _begin;
+            _begin = 0;
+        }
+        int nbytes = read(_storage.get() + _end, int(CAPACITY - _end));
+        if (nbytes == 0)
+            _eof = true;
+        _end += nbytes;
+        return nbytes;
+    }
 
-    int child_pid() const { return _child_pid; }
+    /** Whether the writing end of the pipe has been closed */
+    bool eof() const { return _eof; }
 
 private:
-    ChildProcess(const ChildProcess &) = delete;
-    ChildProcess operator=(const ChildProcess &) = delete;
-
-    pid_t _child_pid;
-    Pipe _to_child, _from_child;
-    mutable std::string _buffer;
+    std::unique_ptr<char[]> _storage;
+    size_t _begin;      // start of the first line not taken yet
+    size_t _scan;       // no newline between _begin and _scan
+    size_t _end;        // end of data
+    bool _eof;
 };
 
-class Player
+/**
+ * Shared memory offered to a program in place of its pipes, see
+ * spieler_shm.h.  The area lives in a memfd that the program inherits as
+ * descriptor 3.  Until the program has answered the offer, lines for it go
+ * to both the pipe and the ring, so it finds them whichever it reads.
+ */
+class SharedMemory
 {
 public:
-    enum Outcome {
-        MISS, HIT, SUNK
-    };
+    enum { FD = 3 };
 
-    Player() : _which('x') { }
+    /** Creates an area to offer; none if the system has no memfd */
+    static SharedMemory create() {
+        SharedMemory shm;
+#ifdef __linux__
+        shm._fd = memfd_create("schiffe_versenken", MFD_CLOEXEC);
+        if (shm._fd == FD) {
+            // dup2() onto itself would keep the close-on-exec flag
+            shm._fd = fcntl(FD, F_DUPFD_CLOEXEC, FD + 1);
+            ::close(FD);
+        }
+        if (shm._fd < 0 || ftruncate(shm._fd, sizeof(spieler_shm::Bereich)) != 0) {
+            shm.close_fd();
+            return shm;
+        }
+        void *area = mmap(NULL, sizeof(spieler_shm::Bereich),
+                          PROT_READ | PROT_WRITE, MAP_SHARED, shm._fd, 0);
+        if (area == MAP_FAILED) {
+            shm.close_fd();
+            return shm;
+        }
+        shm._area = static_cast<spieler_shm::Bereich *>(area);
+        memcpy(shm._area->magie, "SVR1", 4);
+        shm._area->groesse = sizeof(spieler_shm::Bereich);
+#endif
+        return shm;
+    }
 
-    Player(char which, ChildProcess &&child = ChildProcess())
-        : _which(which)
-        , _child(std::move(child))
-        , _live(0)
-    {
-        std::fill_n(&_board[0][0], 100, ' ');
+    /** The environment variable for the offer, "NAME=VALUE" */
+    static std::string variable() {
+        return std::string(spieler_shm::VARIABLE) + "="
+               + std::to_string(int(FD));
     }
 
-    bool is_machine() const { return _child.started(); }
+    SharedMemory() : _area(nullptr), _fd(-1), _active(false) { }
 
-    void die() { _live = 0; }
+    SharedMemory(SharedMemory &&other) : SharedMemory() { swap(*this, other); }
 
-    bool alive() const { return _live > 0; }
+    SharedMemory &operator=(SharedMemory &&other) { swap(*this, other); return *this; }
 
-    char which() const { return _which; }
+    friend void swap(SharedMemory &left, SharedMemory &right) {
+        std::swap(left._area, right._area);
+        std::swap(left._fd, right._fd);
+        std::swap(left._active, right._active);
+    }
 
-    const ChildProcess &child() const { return _child; }
+    ~SharedMemory() {
+        close_fd();
+        if (_area)
+            munmap(_area, sizeof(spieler_shm::Bereich));
+    }
 
-    std::string prompt() const {
-        if (is_machine()) {
-            return _child.getline();
-        } else {
-            std::string line;
-            if (!getline(std::cin, line)) {
-                std::cerr << "Aborted by user\n";
-                exit(96);
-            }
-            return line;
-        }
+    /** Descriptor for the program to inherit, -1 if there is nothing */
+    int fd() const { return _fd; }
+
+    /** Closes the descriptor once the program has inherited it */
+    void close_fd() {
+        if (_fd >= 0)
+            ::close(_fd);
+        _fd = -1;
     }
 
-    void send(char c) const {
-        if (is_machine()) {
-            char msg[3] = {c, '\n', '\0'};
-            _child.send(std::string(msg));
-        } else {
-            std::cout << c << std::endl;
+    /** Whether the program has yet to answer the offer */
+    bool offered() const { return _area && !_active; }
+
+    /** Whether the program has taken the offer */
+    bool active() const { return _active; }
+
+    void activate() { _active = true; }
+
+    /**
+     * Writes `input` for the program, which is gone once `alive_fd` is
+     * closed.  While the offer is open, `input` also goes to the pipe and
+     * is dropped here if the ring is full.
+     */
+    void send(const std::string &input, int alive_fd) const {
+        spieler_shm::Ring &ring = _area->zum_programm;
+        if (!_active) {
+            if (spieler_shm::frei(ring) >= input.size())
+                spieler_shm::schreiben(ring, input.data(), input.size(), 0, -1);
+        } else if (!spieler_shm::schreiben(ring, input.data(), input.size(),
+                                           2000, alive_fd)) {
+            throw std::runtime_error(
+                "Das Spieler-Programm ist wahrscheinlich abgestürzt "
+                "oder ist zu frueh fertig.");
         }
     }
 
-    void check_valid(int r, int c) const {
-        if (r < 0 || r > 9)
-            throw std::runtime_error("Ungueltige Zeile");
-        if (c < 0 || c > 9)
-            throw std::runtime_error("Ungueltige Spalte");
-        if (r != 0 && _board[r-1][c] != ' ')
-            throw std::runtime_error("Schiff beruehrt oben anderes Schiff");
-        if (r != 9 && _board[r+1][c] != ' ')
-            throw std::runtime_error("Schiff beruehrt unten anderes Schiff");
-        if (c != 0 && _board[r][c-1] != ' ')
-            throw std::runtime_error("Schiff beruehrt links anderes Schiff");
-        if (c != 9 && _board[r][c+1] != ' ')
-            throw std::runtime_error("Schiff beruehrt rechts anderes Schiff");
+    /** Like Pipe::read(), but waits up to `timeout` ms for the program */
+    int read(char *buffer, int bufsize, int timeout, int alive_fd) const {
+        int nread = spieler_shm::lesen(_area->vom_programm, buffer, bufsize,
+                                       timeout, alive_fd);
+        if (nread == 0) {
+            throw std::runtime_error(
+                "Timeout: das Spieler-Programm hat innerhalb einiger Zeit "
+                "keine Zeile geschrieben");
+        }
+        return std::max(nread, 0);
     }
 
-    char board(int r, int c) const { return _board[r][c]; }
+private:
+    SharedMemory(const SharedMemory &) = delete;
+    SharedMemory &operator=(const SharedMemory &) = delete;
 
-    void place(int r, int c, int size, bool downward) {
-        if (size <= 0)
-            throw std::runtime_error("Ungueltige Groesse");
-        if (downward) {
-            if (r > 6)
-                throw std::runtime_error("Schiff hat nach unten nicht Platz.");
-            for (int rr = r; rr != r + size; ++rr)
-                check_valid(rr, c);
-            for (int rr = r; rr != r + size; ++rr)
-                _board[rr][c] = 'S';
-        } else {
-            if (c > 6)
-                throw std::runtime_error("Schiff hat nach rechts nicht Platz.");
-            for (int cc = c; cc != c + size; ++cc)
-                check_valid(r, cc);
-            for (int cc = c; cc != c + size; ++cc)
-                _board[r][cc] = 'S';
+    spieler_shm::Bereich *_area;
+    int _fd;
+    bool _active;
+};
+
+/**
+ * CPU time, peak memory and context switches of a program: from wait4() once
+ * it has exited, or from /proc while it is still running (Linux only).
+ */
+struct ResourceUsage
+{
+    ResourceUsage()
+        : user_ns(0), sys_ns(0), max_rss_kb(0), voluntary(0), involuntary(0)
+        , games(0)
+    { }
+
+    static ResourceUsage of(const rusage &usage) {
+        ResourceUsage result;
+        result.user_ns = usage.ru_utime.tv_sec * 1000000000LL
+                         + usage.ru_utime.tv_usec * 1000LL;
+        result.sys_ns = usage.ru_stime.tv_sec * 1000000000LL
+                        + usage.ru_stime.tv_usec * 1000LL;
+        result.max_rss_kb = usage.ru_maxrss;
+        result.voluntary = usage.ru_nvcsw;
+        result.involuntary = usage.ru_nivcsw;
+        return result;
+    }
+
+    static ResourceUsage of_running(pid_t pid) {
+        ResourceUsage result;
+#ifdef __linux__
+        char path[64], buffer[4096];
+        snprintf(path, sizeof(path), "/proc/%d/stat", int(pid));
+        if (_read(path, buffer, sizeof(buffer))) {
+            // utime and stime are fields 14 and 15; the name in field 2 is
+            // in parentheses and may contain anything
+            const char *after_name = strrchr(buffer, ')');
+            unsigned long user, sys;
+            if (after_name && sscanf(after_name + 1, " %*c %*d %*d %*d %*d %*d"
+                                     " %*u %*u %*u %*u %*u %lu %lu",
+                                     &user, &sys) == 2) {
+                long tick_ns = 1000000000L / sysconf(_SC_CLK_TCK);
+                result.user_ns = int64_t(user) * tick_ns;
+                result.sys_ns = int64_t(sys) * tick_ns;
+            }
+        }
+        snprintf(path, sizeof(path), "/proc/%d/status", int(pid));
+        if (_read(path, buffer, sizeof(buffer))) {
+            result.max_rss_kb = _field(buffer, "\nVmHWM:");
+            result.voluntary = _field(buffer, "\nvoluntary_ctxt_switches:");
+            result.involuntary = _field(buffer, "\nnonvoluntary_ctxt_switches:");
         }
-        _live += size;
+#endif
+        return result;
     }
 
-    Outcome incoming(int r, int c) {
-        if (r < 0 || r > 9)
-            throw std::runtime_error("Ungueltige Zeile");
-        if (c < 0 || c > 9)
-            throw std::runtime_error("Ungueltige Spalte");
+    /** What was used since `start`; the peak memory is kept as it is */
+    ResourceUsage operator-(const ResourceUsage &start) const {
+        ResourceUsage result = *this;
+        result.user_ns -= start.user_ns;
+        result.sys_ns -= start.sys_ns;
+        result.voluntary -= start.voluntary;
+        result.involuntary -= start.involuntary;
+        return result;
+    }
 
-        if (_board[r][c] == 'S') {
-            _board[r][c] = 'X';
-            --_live;
-            return _has_alive_ship(r, c) ? HIT : SUNK;
-        } else {
-            if (_board[r][c] == ' ')
-                _board[r][c] = 'o';
-            return MISS;
-        }
+    void merge(const ResourceUsage &other) {
+        user_ns += other.user_ns;
+        sys_ns += other.sys_ns;
+        max_rss_kb = std::max(max_rss_kb, other.max_rss_kb);
+        voluntary += other.voluntary;
+        involuntary += other.involuntary;
+        games += other.games;
+    }
+
+    /** Prints a line with the totals, unless there are no games */
+    void print(std::ostream &out, const std::string &label) const {
+        if (games == 0)
+            return;
+        out << std::left << std::setw(20) << label << std::right
+            << std::setw(8) << games << std::fixed << std::setprecision(3)
+            << std::setw(10) << user_ns / 1e9 << std::setw(10) << sys_ns / 1e9
+            << std::setw(10) << (user_ns + sys_ns) / 1e6 / games
+            << std::setprecision(1) << std::setw(10) << max_rss_kb / 1024.0
+            << std::setw(12) << voluntary << std::setw(12) << involuntary
+            << "\n";
+    }
+
+    static void print_header(std::ostream &out) {
+        out << "Ressourcen [s, MB]    Spiele      user       sys  ms/Spiel"
+               "   max RSS   freiw. KW unfreiw. KW\n";
     }
 
+    int64_t user_ns, sys_ns;
+    long max_rss_kb;
+    long voluntary, involuntary;    // context switches
+    int games;
+
 private:
-    bool _has_alive_ship(int r, int c) {
-        if (_board[r][c] == 'S')
-            return true;
-        if (_board[r][c] != 'X')
+    static bool _read(const char *path, char *buffer, size_t size) {
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
             return false;
-        for (int rr = r-1; rr >= 0; --rr) {
-            if (_board[rr][c] == 'S')
-                return true;
-            if (_board[rr][c] != 'X')
-                break;
-        }
-        for (int rr = r+1; rr <= 9; ++rr) {
-            if (_board[rr][c] == 'S')
-                return true;
-            if (_board[rr][c] != 'X')
-                break;
-        }
-        for (int cc = c-1; cc >= 0; --cc) {
-            if (_board[r][cc] == 'S')
-                return true;
-            if (_board[r][cc] != 'X')
-                break;
-        }
-        for (int cc = c+1; cc <= 9; ++cc) {
-            if (_board[r][cc] == 'S')
-                return true;
-            if (_board[r][cc] != 'X')
-                break;
-        }
-        return false;
+        ssize_t nread = read(fd, buffer, size - 1);
+        close(fd);
+        if (nread <= 0)
+            return false;
+        buffer[nread] = '\0';
+        return true;
     }
 
-    char _which;
-    ChildProcess _child;
-    char _board[10][10];
-    int _live;
+    static long _field(const char *buffer, const char *key) {
+        const char *found = strstr(buffer, key);
+        return found ? atol(found + strlen(key)) : 0;
+    }
 };
 
-void print_usage(std::string name)
+/**
+ * Board and fleet of a variant as the players learn them: plugins through
+ * spieler_neu_variante(), programs from the environment variable
+ * SCHIFFE_VARIANTE, bot servers in the line that begins a game.  The
+ * standard game is never announced, so players that only know it keep
+ * working.
+ */
+struct GameVariant
 {
-    std::cerr << "Schiffe versenken v" << VERSION << ". Verwendung:\n\n"
-              << "    " << name << " SPIELER_A SPIELER_B\n\n"
-              << "Fuer SPIELER_A oder SPIELER_B kann eingesetzt werden:\n\n"
-              << "    - 'mensch': Spieler spielt ueber die Tastatur\n"
-              << "    - './PROGRAMMNAME': Spieler ist ein Programm\n";
-}
+    GameVariant() : rows(10), cols(10), ships(4, 4) { }
 
-Player make_player(std::string spec, char which)
-{
-    std::cerr << "Spieler " << which;
-    if (spec == "mensch") {
-        std::cerr << " ist ein Mensch ...\n";
-        return Player(which);
+    template <typename Rules>
+    static GameVariant of() {
+        GameVariant variant;
+        variant.rows = Rules::rows;
+        variant.cols = Rules::cols;
+        variant.ships.assign(Rules::ship_sizes,
+                             Rules::ship_sizes + Rules::nships);
+        return variant;
     }
-    if (spec.find('/') == std::string::npos) {
-        throw std::runtime_error(
-                "Programm '" + spec + "' muss ausfuehrbarer Pfad sein.\n"
-                "(Vielleicht ist ./" + spec + " gemeint?)\n");
+
+    bool standard() const {
+        GameVariant standard;
+        return rows == standard.rows && cols == standard.cols
+               && ships == standard.ships;
     }
-    std::cerr << " ist das Programm `" << spec << "', starte dieses ...\n";
-    return Player(which, ChildProcess(spec));
-}
 
-void print_board(std::ostream &out, const Player &player, bool visible, int row)
-{
-    if (row == 0 || row == 13) {
-        out << player.which() << " | 0 1 2 3 4 5 6 7 8 9 | " << player.which();
-    } else if (row == 1 || row == 12) {
-        out << "--+---------------------+--";
-    } else if (row <= 11) {
-        row -= 2;
-        out << row << " | ";
-        for (int c = 0; c != 10; ++c) {
-            char field = player.board(row, c);
-            if (visible || field == 'o' || field == 'X')
-                out << (field == ' ' ? '.' : field) << ' ';
-            else
-                out << ". ";
-        }
-        out << "| " << row;
+    /** E.g. "10 10 5 4 3 3 2": rows, columns and the ships in order */
+    std::string numbers() const {
+        std::string text = std::to_string(rows) + " " + std::to_string(cols);
+        for (size_t k = 0; k != ships.size(); ++k)
+            text += " " + std::to_string(ships[k]);
+        return text;
     }
-}
 
-void print_boards(std::ostream &out, const Player &me, const Player &other,
-                  bool other_visible)
+    int rows, cols;
+    std::vector<int> ships;
+};
+
+/** Limits for every program the referee starts; 0 means no limit */
+struct ResourceLimits
 {
-    out << "\n";
-    for (int r = 0; r != 14; ++r) {
-        out << "        ";
-        print_board(out, me, true, r);
-        out << "          ";
-        print_board(out, other, other_visible, r);
-        out << "\n";
-    }
-    out << std::endl;
-}
+    ResourceLimits() : cpu_s(0), memory_mb(0) { }
+
+    int cpu_s;              // CPU seconds over the lifetime of the process
+    int memory_mb;          // address space
+};
 
-void place(Player &me)
+class ChildProcess
 {
-    Player dummy = Player(me.which() == 'A' ? 'B' : 'A');
-    bool am_human = !me.is_machine();
-    for (int ship=1; ship<=4; ++ship) {
-        // Be nice to humans
-        if (am_human)
-            print_boards(std::cerr, me, dummy, false);
+public:
+    /**
+     * Protocol spoken by the program.  A program that writes the line "MULTI"
+     * before its first placement is able to play several games in a row; it
+     * is only known after the first line has been read.
+     */
+    enum Protocol {
+        UNKNOWN, SINGLE_GAME, MULTI_GAME
+    };
 
-        std::string line;
-        for (bool ok = false; !ok;) {
-            std::cerr << "Spieler " << me.which()
-                      << " - Schiff #" << ship << " eingeben: ";
-            line = me.prompt();
-            if (line.empty())
-                continue;
+    ChildProcess()
+        : _child_pid(-1), _slot(-1), _protocol(UNKNOWN), _knows_variant(false)
+        , _filled_ns(0) { }
 
-            std::istringstream linestr(line);
-            int i, j;
-            char c;
-            linestr >> i >> j >> c >> std::ws;
-            try {
-                if (!linestr.eof() || linestr.fail()) {
-                    throw std::runtime_error(
-                        "Ungueltige Eingabe - erwarte eine Zeile der Form:\n\n"
-                        "   zeile spalte richtung\n\n"
-                        "zeile, spalte kann eine Zahl von 0-9 sein, Richtung muss\n"
-                        "entweder U oder R sein");
-                }
-                if (c != 'R' && c != 'U') {
-                    throw std::runtime_error(
-                        "Ungueltige Richtung: muss entweder 'R' oder 'U' sein");
-                }
-                me.place(i, j, 4, c == 'U');
-                ok = true;
-                if (!am_human)
-                    std::cerr << "[Erfolgreich eigegeben, aber geheim]\n";
-            } catch(const std::runtime_error &e) {
-                if (am_human) {
-                    std::cerr << "Eingabefehler Spieler " << me.which() << ":\n"
-                              << e.what() << std::endl;
-                } else {
-                    std::cerr << "\nBisher gesetzt:\n";
-                    print_boards(std::cerr, me, dummy, false);
-                    std::cerr << "\nEingeben wurde:\n" << line;
-                    throw;
-                }
-            }
+    /**
+     * Starts the program `name`.  posix_spawn() does not copy the page tables
+     * of the referee as fork() would, so starting stays cheap however much
+     * memory a tournament holds.  If the program cannot be executed, it
+     * behaves like one that exited at once.
+     */
+    ChildProcess(std::string name)
+        : _to_child(Pipe::open())
+        , _from_child(Pipe::open())
+        , _protocol(UNKNOWN)
+        , _knows_variant(false)
+        , _filled_ns(0)
+        , _shm(shared_memory() ? SharedMemory::create() : SharedMemory())
+    {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, _to_child.fd_read(),
+                                         STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, _from_child.fd_write(),
+                                         STDOUT_FILENO);
+        std::vector<std::string> variables;
+        if (_shm.fd() >= 0) {
+            posix_spawn_file_actions_adddup2(&actions, _shm.fd(),
+                                             SharedMemory::FD);
+            variables.push_back(SharedMemory::variable());
+        }
+        if (!variant().standard())
+            variables.push_back("SCHIFFE_VARIANTE=" + variant().numbers());
+        std::vector<char *> environment = _environment(variables);
+
+        // ignored signals stay ignored across exec, see run_tournament()
+        posix_spawnattr_t attributes;
+        sigset_t defaults;
+        posix_spawnattr_init(&attributes);
+        sigemptyset(&defaults);
+        sigaddset(&defaults, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attributes, &defaults);
+        posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+        char *argv[] = {&name[0], NULL};
+        pid_t pid;
+        int error = posix_spawn(&pid, name.c_str(), &actions, &attributes,
+                                argv, environment.empty() ? environ
+                                                          : environment.data());
+        posix_spawnattr_destroy(&attributes);
+        posix_spawn_file_actions_destroy(&actions);
+        if (error == 0) {
+            _child_pid = pid;
+            _slot = ChildRegistry::add(pid);
+            _limit(limits());
+        } else {
+            _child_pid = -1;
+            _slot = -1;
+            std::cerr << "\nFEHLER beim Ausführen von `" << name << "': "
+                      << strerror(error) << std::endl;
         }
+
+        _to_child.close_read();
+        _from_child.close_write();
+        _shm.close_fd();
     }
-    if (am_human)
-        print_boards(std::cerr, me, dummy, false);
-}
 
-void shoot(Player &me, Player &other)
-{
-    bool am_human = !me.is_machine();
-    static const std::string outcomestr[] =
-                        {" - daneben. ", " - TREFFER! ", " - VERSENKT!"};
-    static const char outcomechar[] = {'F', 'T', 'V'};
+    ~ChildProcess() { stop(); }
 
-    // Be nice to humans
-    if (am_human)
-        print_boards(std::cerr, me, other, false);
+    /** Games a process may play with a CPU limit before it is replaced */
+    enum { CPU_LIMIT_GAMES = 16 };
 
-    std::string line;
-    Player::Outcome treffer;
-    int i, j;
-    for (bool ok = false; !ok;) {
-        std::cerr << "Spieler " << me.which() << " - Zielfeld eingeben: ";
-        line = me.prompt();
-        if (line.empty())
-            continue;
+    /** Limits applied to every program started from now on */
+    static ResourceLimits &limits() {
+        static ResourceLimits limits;
+        return limits;
+    }
 
-        std::istringstream linestr(line);
-        linestr >> i >> j >> std::ws;
-        try {
-            if (!linestr.eof() || linestr.fail()) {
-                throw std::runtime_error(
-                    "Ungueltige Eingabe - erwarte eine Zeile der Form:\n\n"
-                    "   zeile spalte\n\n"
-                    "zeile, spalte kann eine Zahl von 0-9 sein");
-            }
-            treffer = other.incoming(i, j);
-            ok = true;
-        } catch(const std::runtime_error &e) {
-            std::cerr << "Eingabefehler Spieler " << me.which() << ":\n"
-                        << e.what() << std::endl;
-            if (!am_human) {
-                std::cerr << "\nJetziges Feld:\n";
-                print_boards(std::cerr, me, other, true);
-                std::cerr << "\nEingeben wurde:\n" << line;
-                throw;
-            }
-        }
+    /** Whether programs started from now on are offered shared memory */
+    static bool &shared_memory() {
+        static bool offer = false;
+        return offer;
+    }
+
+    /** The variant programs started from now on are told to play */
+    static GameVariant &variant() {
+        static GameVariant variant;
+        return variant;
+    }
+
+    /** Kills the program, if still running, and collects its resource usage */
+    void stop() {
+        if (_child_pid >= 0) {
+            monitored(kill(_child_pid, SIGKILL));
+            ChildRegistry::remove(_slot);
+            _slot = -1;
+            rusage usage;
+            if (monitored(wait4(_child_pid, NULL, 0, &usage)) >= 0)
+                _usage = ResourceUsage::of(usage);
+            _child_pid = -1;
+        }
+    }
+
+    /**
+     * Resources used since the last call, or since the program was started;
+     * counted as one game.  Call stop() first for a program that is done, so
+     * that its usage is complete.
+     */
+    ResourceUsage take_usage() {
+        ResourceUsage total = _child_pid >= 0
+                            ? ResourceUsage::of_running(_child_pid) : _usage;
+        ResourceUsage used = total - _taken;
+        used.games = 1;
+        _taken = total;
+        return used;
+    }
+
+    // copy-and-swap idiom
+    ChildProcess(ChildProcess &&other) : ChildProcess() { swap(*this, other); }
+
+    ChildProcess &operator=(ChildProcess &&other) { swap(*this, other); return *this; }
+
+    friend void swap(ChildProcess &left, ChildProcess &right) {
+        using std::swap;
+        swap(left._child_pid, right._child_pid);
+        swap(left._slot, right._slot);
+        swap(left._from_child, right._from_child);
+        swap(left._to_child, right._to_child);
+        swap(left._output, right._output);
+        swap(left._protocol, right._protocol);
+        swap(left._knows_variant, right._knows_variant);
+        swap(left._filled_ns, right._filled_ns);
+        swap(left._usage, right._usage);
+        swap(left._taken, right._taken);
+        swap(left._shm, right._shm);
+    }
+
+    /** Whether a program was started, even if it could not be executed */
+    bool started() const { return _from_child.fd_read() >= 0; }
+
+    Protocol protocol() const { return _protocol; }
+
+    void set_protocol(Protocol protocol) { _protocol = protocol; }
+
+    /**
+     * Whether the program declared with the line "VARIANTE", ahead of its
+     * protocol, that it plays the variant in SCHIFFE_VARIANTE
+     */
+    bool knows_variant() const { return _knows_variant; }
+
+    void set_knows_variant() { _knows_variant = true; }
+
+    /**
+     * Returns the next line, which is valid until the next read.  The line
+     * "SHM" in answer to an offer of shared memory is handled here.
+     */
+    LineView getline(int maxlen=200, int timeout=2000) {
+        if (_shm.active())
+            return _shm_getline(maxlen, timeout);
+        LineView line = _output.getline(_from_child, maxlen, timeout);
+        if (_shm.offered()) {
+            if (!(line == "SHM\n")) {
+                _shm = SharedMemory();
+                return line;
+            }
+            _shm.activate();
+            return _shm_getline(maxlen, timeout);
+        }
+        return line;
+    }
+
+    /** Whether the program plays through shared memory */
+    bool uses_shared_memory() const { return _shm.active(); }
+
+    /**
+     * Reads what the program has written so far.  Only call this once poll()
+     * or epoll reported the pipe as readable, otherwise it blocks.
+     */
+    void fill() {
+        _output.fill(_from_child);
+        _filled_ns = monotonic_ns();
+    }
+
+    /** When fill() last read, i.e. when the latest of its lines arrived */
+    uint64_t filled_ns() const { return _filled_ns; }
+
+    /** Whether the program has closed its output */
+    bool eof() const { return _output.eof(); }
+
+    /**
+     * Takes the next complete line from what fill() has read and returns
+     * true, or returns false if the program has yet to finish the line.
+     */
+    bool try_getline(LineView &line, int maxlen=200) {
+        return _output.try_getline(line, maxlen);
+    }
+
+    void send(const std::string &input) const {
+        if (!_shm.active())
+            _to_child.write(input.c_str(), input.size());
+        if (_shm.offered() || _shm.active())
+            _shm.send(input, _from_child.fd_read());
+    }
+
+    const Pipe &to_child() const { return _to_child; }
+
+    const Pipe &from_child() const { return _from_child; }
+
+    int child_pid() const { return _child_pid; }
+
+    /**
+     * Grants the program the CPU limit anew for the game it begins now.
+     * RLIMIT_CPU counts over the life of a process, so a program that plays
+     * several games, or was started ahead of time, gets the CPU time it has
+     * used so far added on top.  Only the root may raise the hard limit, so
+     * this fails once the program has used up CPU_LIMIT_GAMES limits; it
+     * should be stopped then.
+     */
+    bool renew_cpu_limit() {
+#ifdef __linux__
+        if (limits().cpu_s <= 0 || _child_pid < 0)
+            return true;
+        ResourceUsage used = ResourceUsage::of_running(_child_pid);
+        rlim_t used_s = (used.user_ns + used.sys_ns + 999999999) / 1000000000;
+        rlimit cpu;
+        if (prlimit(_child_pid, RLIMIT_CPU, NULL, &cpu) != 0
+            || used_s + limits().cpu_s >= cpu.rlim_max)
+            return false;
+        cpu.rlim_cur = used_s + limits().cpu_s;
+        return prlimit(_child_pid, RLIMIT_CPU, &cpu, NULL) == 0;
+#else
+        return true;
+#endif
+    }
+
+private:
+    ChildProcess(const ChildProcess &) = delete;
+    ChildProcess operator=(const ChildProcess &) = delete;
+
+    /**
+     * Applies `limits` to the program just started.  posix_spawn() offers no
+     * way to do so in the child before exec, so the program may run for a
+     * moment without them.
+     */
+    void _limit(const ResourceLimits &limits) {
+#ifdef __linux__
+        if (limits.cpu_s > 0) {
+            // the hard limit kills a program that ignores SIGXCPU; it leaves
+            // room to renew the soft limit for further games
+            rlimit cpu = {rlim_t(limits.cpu_s),
+                          rlim_t(limits.cpu_s) * CPU_LIMIT_GAMES + 1};
+            monitored(prlimit(_child_pid, RLIMIT_CPU, &cpu, NULL));
+        }
+        if (limits.memory_mb > 0) {
+            rlimit memory = {rlim_t(limits.memory_mb) << 20,
+                             rlim_t(limits.memory_mb) << 20};
+            monitored(prlimit(_child_pid, RLIMIT_AS, &memory, NULL));
+        }
+#endif
+    }
+
+    /**
+     * The environment of the referee with `variables` ("NAME=VALUE") set,
+     * for posix_spawn(); empty if there are none, i.e. to use `environ`
+     */
+    static std::vector<char *> _environment(
+                                    std::vector<std::string> &variables) {
+        std::vector<char *> result;
+        if (variables.empty())
+            return result;
+        for (char **entry = environ; *entry; ++entry) {
+            bool replaced = false;
+            for (size_t k = 0; k != variables.size(); ++k) {
+                replaced |= strncmp(*entry, variables[k].c_str(),
+                                    variables[k].find('=') + 1) == 0;
+            }
+            if (!replaced)
+                result.push_back(*entry);
+        }
+        for (size_t k = 0; k != variables.size(); ++k)
+            result.push_back(&variables[k][0]);
+        result.push_back(NULL);
+        return result;
+    }
+
+    LineView _shm_getline(int maxlen, int timeout) {
+        LineView line;
+        while (!_output.try_getline(line, maxlen)) {
+            _output.fill_with([this, timeout](char *buffer, int size) {
+                return _shm.read(buffer, size, timeout, _from_child.fd_read());
+            });
+        }
+        return line;
+    }
+
+    pid_t _child_pid;
+    int _slot;                      // in ChildRegistry
+    Pipe _to_child, _from_child;
+    LineBuffer _output;
+    Protocol _protocol;
+    bool _knows_variant;
+    uint64_t _filled_ns;            // see filled_ns()
+    ResourceUsage _usage;           // once the program has exited
+    ResourceUsage _taken;           // until the last take_usage()
+    SharedMemory _shm;
+};
+
+/**
+ * Shared library of a player plugin, see spieler_plugin.h.  Each library is
+ * loaded once and stays loaded until the referee exits.
+ */
+struct PluginLibrary
+{
+    static const PluginLibrary &load(const std::string &path) {
+        static std::mutex mutex;
+        static std::map<std::string, PluginLibrary> loaded;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::map<std::string, PluginLibrary>::iterator it = loaded.find(path);
+        if (it != loaded.end())
+            return it->second;
+
+        void *handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            throw std::runtime_error(
+                    "Kann Plugin '" + path + "' nicht laden: " + dlerror());
+        }
+        PluginLibrary library;
+        try {
+            library.version = (int (*)())_symbol(handle, path,
+                                                 "spieler_version");
+            library.start = (spieler_spiel *(*)())_symbol(handle, path,
+                                                          "spieler_neu");
+            library.place = (void (*)(spieler_spiel *, int, int *, int *,
+                                      char *))
+                            _symbol(handle, path, "spieler_setzen");
+            library.shoot = (void (*)(spieler_spiel *, int *, int *))
+                            _symbol(handle, path, "spieler_schiessen");
+            library.outcome = (void (*)(spieler_spiel *, char))
+                              _symbol(handle, path, "spieler_ergebnis");
+            library.end = (void (*)(spieler_spiel *))
+                          _symbol(handle, path, "spieler_ende");
+            library.start_variant = (spieler_spiel *(*)(int, int, int,
+                                                        const int *))
+                                    dlsym(handle, "spieler_neu_variante");
+            if (library.version() != SPIELER_PLUGIN_VERSION) {
+                throw std::runtime_error(
+                        "Plugin '" + path + "' hat die falsche Version");
+            }
+        } catch(const std::runtime_error &e) {
+            dlclose(handle);
+            throw;
+        }
+        return loaded[path] = library;
+    }
+
+    int (*version)();
+    spieler_spiel *(*start)();
+    void (*place)(spieler_spiel *, int, int *, int *, char *);
+    void (*shoot)(spieler_spiel *, int *, int *);
+    void (*outcome)(spieler_spiel *, char);
+    void (*end)(spieler_spiel *);
+    spieler_spiel *(*start_variant)(int, int, int, const int *);  // optional
+
+    /** Whether the plugin can play `variant` at all */
+    bool plays(const GameVariant &variant) const {
+        return variant.standard() || start_variant;
+    }
+
+    /** Begins a game of `variant`, or returns NULL */
+    spieler_spiel *start_game(const GameVariant &variant) const {
+        if (variant.standard())
+            return start();
+        if (!start_variant)
+            return nullptr;
+        return start_variant(variant.rows, variant.cols, variant.ships.size(),
+                             variant.ships.data());
+    }
+
+private:
+    static void *_symbol(void *handle, const std::string &path,
+                         const char *name) {
+        void *symbol = dlsym(handle, name);
+        if (!symbol) {
+            throw std::runtime_error(
+                    "Plugin '" + path + "' fehlt die Funktion " + name);
+        }
+        return symbol;
+    }
+};
+
+/**
+ * A player plugin in a game.  It behaves like a program that writes its
+ * moves as lines, only that each line is produced by a direct call.
+ */
+class PluginBot
+{
+public:
+    /** Whether `spec` names a plugin, i.e., is "lib:PFAD" */
+    static bool is_spec(const std::string &spec) {
+        return spec.compare(0, 4, "lib:") == 0;
+    }
+
+    PluginBot() : _library(nullptr), _game(nullptr), _plays(true), _nships(0),
+                  _ships(0) { }
+
+    PluginBot(const std::string &spec,
+              const GameVariant &variant = GameVariant())
+        : _library(&PluginLibrary::load(spec.substr(4)))
+        , _game(_library->start_game(variant))
+        , _plays(_library->plays(variant))
+        , _nships(variant.ships.size())
+        , _ships(0)
+    { }
+
+    PluginBot(PluginBot &&other) : PluginBot() { swap(*this, other); }
+
+    PluginBot &operator=(PluginBot &&other) { swap(*this, other); return *this; }
+
+    ~PluginBot() {
+        if (_game)
+            _library->end(_game);
+    }
+
+    friend void swap(PluginBot &left, PluginBot &right) {
+        using std::swap;
+        swap(left._library, right._library);
+        swap(left._game, right._game);
+        swap(left._plays, right._plays);
+        swap(left._nships, right._nships);
+        swap(left._ships, right._ships);
+    }
+
+    bool started() const { return _library != nullptr; }
+
+    /** Asks for a ship first, then for shots; valid until the next call */
+    LineView getline() {
+        if (!_game) {
+            throw std::runtime_error(_plays
+                    ? "Das Plugin konnte kein Spiel beginnen."
+                    : "Das Plugin kennt keine Varianten "
+                      "(spieler_neu_variante fehlt).");
+        }
+        int r = 0, c = 0, size;
+        if (_ships != _nships) {
+            char direction = 0;
+            _library->place(_game, _ships++, &r, &c, &direction);
+            size = snprintf(_line, sizeof(_line), "%d %d %c\n", r, c, direction);
+        } else {
+            _library->shoot(_game, &r, &c);
+            size = snprintf(_line, sizeof(_line), "%d %d\n", r, c);
+        }
+        return LineView(_line, size);
+    }
+
+    void send(char c) {
+        if (_game)
+            _library->outcome(_game, c);
+    }
+
+private:
+    PluginBot(const PluginBot &) = delete;
+    PluginBot &operator=(const PluginBot &) = delete;
+
+    const PluginLibrary *_library;
+    spieler_spiel *_game;
+    bool _plays;                            // the variant, see getline()
+    int _nships, _ships;                    // in all, placed
+    char _line[32];
+};
+
+/**
+ * Connection to a bot server listening on a Unix domain socket, shared by
+ * all games against that server.  Every line in either direction starts
+ * with the number of the game it belongs to, so that one connection carries
+ * many games at once:
+ *
+ *     17 N            referee: game 17 begins
+ *     17 3 4 R        server: a ship of game 17, later shots
+ *     17 F            referee: an outcome, as for programs
+ *     17 ENDE         referee: game 17 is over, forget it
+ *
+ * Apart from the number, the lines are those of the protocol for programs.
+ * Games of other variants begin with "N" and the numbers of the variant,
+ * e.g. "17 N 10 10 5 4 3 3 2" (see GameVariant); a server that cannot play
+ * it does not answer.
+ * Whichever game waits for a line first reads from the socket and sorts
+ * what comes into the queues of the games, until its own line is there;
+ * then the next waiting game takes over.  So the common case of a line for
+ * the game that reads costs no hand-over between threads.  Lines of games
+ * that are over are dropped.  bot_server.cpp is a server to test with.
+ */
+class BotConnection
+{
+public:
+    /** The connection to the server at `path`, connecting if there is none */
+    static std::shared_ptr<BotConnection> get(const std::string &path) {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<BotConnection> > open;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<BotConnection> &connection = open[path];
+        if (!connection || connection->broken())
+            connection.reset(new BotConnection(path));
+        return connection;
+    }
+
+    ~BotConnection() { ::close(_fd); }
+
+    bool broken() const {
+        std::lock_guard<std::mutex> lock(_mutex);
+        return _broken;
+    }
+
+    /** Begins a new game of `variant` and returns its number */
+    unsigned open(const GameVariant &variant) {
+        unsigned id;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            id = _next_id++;
+            _games[id].reset(new Game());
+        }
+        send(id, variant.standard() ? "N\n"
+                                    : "N " + variant.numbers() + "\n");
+        return id;
+    }
+
+    /** Ends game `id`; the server is told, and later lines are dropped */
+    void close(unsigned id) {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _games.erase(id);
+        }
+        try {
+            send(id, "ENDE\n");
+        } catch(const std::runtime_error &e) {
+            // the server is gone, and the game with it
+        }
+    }
+
+    /** Sends `lines` of game `id`, each of which must end in a newline */
+    void send(unsigned id, const std::string &lines) {
+        std::string prefix = std::to_string(id) + " ", message;
+        for (size_t begin = 0; begin < lines.size(); ) {
+            size_t end = lines.find('\n', begin) + 1;
+            message += prefix;
+            message.append(lines, begin, end - begin);
+            begin = end;
+        }
+
+        // one write per message, so that messages of games never mix
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        for (size_t done = 0; done != message.size(); ) {
+            ssize_t n = ::send(_fd, message.data() + done,
+                               message.size() - done, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                throw std::runtime_error("Verbindung zum Bot-Server "
+                                         "unterbrochen: " + _path);
+            }
+            done += n;
+        }
+    }
+
+    /**
+     * Waits up to `timeout` ms for the next line of game `id` and stores it
+     * in `line`, with its newline but without the number.  Returns false if
+     * none came in time.
+     */
+    bool getline(unsigned id, std::string &line, int timeout) {
+        std::unique_lock<std::mutex> lock(_mutex);
+        std::map<unsigned, std::unique_ptr<Game> >::iterator it =
+                                                            _games.find(id);
+        if (it == _games.end())
+            throw std::logic_error("game is not open");
+        Game &game = *it->second;
+        std::chrono::steady_clock::time_point deadline =
+                std::chrono::steady_clock::now()
+                + std::chrono::milliseconds(timeout);
+
+        bool in_time = true;
+        while (game.lines.empty() && !_broken && in_time) {
+            if (_reading) {
+                game.waiting = true;
+                in_time = game.arrived.wait_until(lock, deadline)
+                          == std::cv_status::no_timeout;
+                game.waiting = false;
+                continue;
+            }
+            _reading = true;
+            lock.unlock();
+            int left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+            pollfd poll_info;
+            poll_info.fd = _fd;
+            poll_info.events = POLLIN;
+            int ready = poll(&poll_info, 1, std::max(left, 0));
+            ssize_t n = ready > 0 ? ::read(_fd, _buffer, sizeof(_buffer)) : 0;
+            lock.lock();
+            _reading = false;
+            if (ready == 0 || (ready < 0 && errno == EINTR)
+                    || (n < 0 && errno == EINTR))
+                in_time = ready != 0;
+            else if (n <= 0 || !_dispatch(n))
+                _broken = true;
+            _hand_over();
+        }
+
+        if (!game.lines.empty()) {
+            line.swap(game.lines.front());
+            game.lines.pop_front();
+            return true;
+        }
+        if (_broken) {
+            throw std::runtime_error("Der Bot-Server hat die Verbindung "
+                                     "beendet: " + _path);
+        }
+        return false;
+    }
+
+private:
+    enum { MAX_LINE = 600 };
+
+    struct Game {
+        Game() : waiting(false) { }
+
+        std::deque<std::string> lines;
+        std::condition_variable arrived;
+        bool waiting;
+    };
+
+    BotConnection(const std::string &path)
+        : _path(path)
+        , _fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0))
+        , _broken(false)
+        , _reading(false)
+        , _next_id(1)
+    {
+        sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            ::close(_fd);
+            throw std::runtime_error("Pfad des Bot-Servers ist zu lang: "
+                                     + path);
+        }
+        strcpy(address.sun_path, path.c_str());
+        if (_fd < 0 || ::connect(_fd, reinterpret_cast<sockaddr *>(&address),
+                                 sizeof(address)) != 0) {
+            std::string error = strerror(errno);
+            if (_fd >= 0)
+                ::close(_fd);
+            throw std::runtime_error("Kann nicht mit Bot-Server '" + path
+                                     + "' verbinden: " + error);
+        }
+    }
+
+    BotConnection(const BotConnection &) = delete;
+    BotConnection &operator=(const BotConnection &) = delete;
+
+    /**
+     * Sorts the `n` bytes just read into the queues of their games and wakes
+     * these.  Returns false if the server writes overlong lines.
+     */
+    bool _dispatch(size_t n) {
+        const char *begin = _buffer, *end = _buffer + n, *newline;
+        while ((newline = static_cast<const char *>(
+                        memchr(begin, '\n', end - begin))) != NULL) {
+            _partial.append(begin, newline + 1);
+            begin = newline + 1;
+
+            char *rest;
+            unsigned long id = strtoul(_partial.c_str(), &rest, 10);
+            std::map<unsigned, std::unique_ptr<Game> >::iterator it =
+                                                            _games.find(id);
+            if (*rest == ' ' && it != _games.end()) {
+                it->second->lines.push_back(rest + 1);
+                if (it->second->waiting)
+                    it->second->arrived.notify_one();
+            }
+            _partial.clear();
+        }
+        _partial.append(begin, end);
+        return _partial.size() <= MAX_LINE;
+    }
+
+    /**
+     * Wakes a game that still waits for a line, so that it reads next, or
+     * all of them if the connection is broken.
+     */
+    void _hand_over() {
+        std::map<unsigned, std::unique_ptr<Game> >::iterator it;
+        for (it = _games.begin(); it != _games.end(); ++it) {
+            Game &game = *it->second;
+            if (!game.waiting || (!_broken && !game.lines.empty()))
+                continue;
+            game.arrived.notify_one();
+            if (!_broken)
+                return;
+        }
+    }
+
+    std::string _path;
+    int _fd;
+    mutable std::mutex _mutex;
+    std::mutex _write_mutex;
+    std::map<unsigned, std::unique_ptr<Game> > _games;
+    bool _broken;
+    bool _reading;          // a game is reading from the socket
+    unsigned _next_id;
+    char _buffer[LineBuffer::CAPACITY];     // only for the reading game
+    std::string _partial;
+};
+
+/**
+ * A player that is a game on a bot server (see BotConnection).  It behaves
+ * like a program, only that its lines go over the shared connection.  If
+ * the server cannot be reached, it behaves like a program that exited at
+ * once: the game fails at its first line.
+ */
+class SocketBot
+{
+public:
+    /** Whether `spec` names a bot server, i.e., is "unix:PFAD" */
+    static bool is_spec(const std::string &spec) {
+        return spec.compare(0, 5, "unix:") == 0;
+    }
+
+    SocketBot() : _id(0) { }
+
+    SocketBot(const std::string &spec,
+              const GameVariant &variant = GameVariant()) : _id(0) {
+        try {
+            _connection = BotConnection::get(spec.substr(5));
+            _id = _connection->open(variant);
+        } catch(const std::runtime_error &e) {
+            _connection.reset();
+            _error = e.what();
+        }
+    }
+
+    SocketBot(SocketBot &&other) : SocketBot() { swap(*this, other); }
+
+    SocketBot &operator=(SocketBot &&other) { swap(*this, other); return *this; }
+
+    ~SocketBot() {
+        if (_connection)
+            _connection->close(_id);
+    }
+
+    friend void swap(SocketBot &left, SocketBot &right) {
+        using std::swap;
+        swap(left._connection, right._connection);
+        swap(left._id, right._id);
+        swap(left._line, right._line);
+        swap(left._error, right._error);
+    }
+
+    bool started() const { return _connection || !_error.empty(); }
+
+    void send(const std::string &lines) {
+        if (!_connection)
+            throw std::runtime_error(_error);
+        _connection->send(_id, lines);
+    }
+
+    /** Waits up to `timeout` ms for a line; valid until the next call */
+    LineView getline(int timeout) {
+        if (!_connection)
+            throw std::runtime_error(_error);
+        if (!_connection->getline(_id, _line, timeout)) {
+            throw std::runtime_error(
+                "Timeout: der Bot-Server hat innerhalb einiger Zeit "
+                "keine Zeile geschrieben");
+        }
+        return LineView(_line);
+    }
+
+private:
+    SocketBot(const SocketBot &) = delete;
+    SocketBot &operator=(const SocketBot &) = delete;
+
+    std::shared_ptr<BotConnection> _connection;
+    unsigned _id;
+    std::string _line;
+    std::string _error;     // why there is no connection
+};
+
+/**
+ * Rules of a variant of the game, fixed at compile time: the size of the
+ * board, the number of moves after which the game is a draw, and the lengths
+ * of the ships in the order they are placed.  Boards, players and the game
+ * loop are templates on the variant, so every variant is compiled for its
+ * own geometry and the standard game pays nothing for the others.
+ */
+template <int ROWS, int COLS, int MAX_MOVES, int... SHIPS>
+struct Variant
+{
+    enum {
+        rows = ROWS, cols = COLS, fields = ROWS * COLS,
+        max_moves = MAX_MOVES, nships = sizeof...(SHIPS)
+    };
+
+    static constexpr int ship_sizes[nships] = {SHIPS...};
+
+    /** E.g. "10x10 5-4-3-3-2", to tell the variant in logs */
+    static std::string describe() {
+        std::string text = std::to_string(rows) + "x" + std::to_string(cols);
+        for (int k = 0; k != nships; ++k)
+            text += (k ? "-" : " ") + std::to_string(ship_sizes[k]);
+        return text;
+    }
+};
+
+template <int ROWS, int COLS, int MAX_MOVES, int... SHIPS>
+constexpr int Variant<ROWS, COLS, MAX_MOVES, SHIPS...>::ship_sizes[];
+
+/** The game of the exercise: four ships of length 4 on 10x10 fields */
+typedef Variant<10, 10, 100, 4, 4, 4, 4> Standard;
+
+/** The fleet of the classic board game */
+typedef Variant<10, 10, 100, 5, 4, 3, 3, 2> Mixed;
+
+/** A larger board with a larger fleet */
+typedef Variant<15, 15, 225, 5, 4, 4, 3, 3, 2> Large;
+
+/** Largest board and fleet of all variants, for fixed-size buffers */
+enum { MAX_FIELDS = Large::fields, MAX_SHIPS = Large::nships };
+
+/**
+ * Set of fields of a board with ROWS x COLS fields, stored as a bit mask:
+ * field (r, c) is bit COLS*r + c, so the standard 100 fields fit into two
+ * machine words.
+ */
+template <int ROWS, int COLS>
+class BasicBoardMask
+{
+public:
+    enum { WORDS = (ROWS * COLS + 63) / 64 };
+
+    BasicBoardMask() {
+        for (int k = 0; k != WORDS; ++k)
+            _w[k] = 0;
+    }
+
+    static BasicBoardMask field(int r, int c) {
+        // written without branches, since shots land anywhere
+        int i = COLS * r + c;
+        BasicBoardMask mask;
+        for (int k = 0; k != WORDS; ++k)
+            mask._w[k] = uint64_t(k == (i >> 6)) << (i & 63);
+        return mask;
+    }
+
+    static const BasicBoardMask &all() {
+        static const BasicBoardMask mask = _columns(0, COLS);
+        return mask;
+    }
+
+    static const BasicBoardMask &left_column() {
+        static const BasicBoardMask mask = _columns(0, 1);
+        return mask;
+    }
+
+    static const BasicBoardMask &right_column() {
+        static const BasicBoardMask mask = _columns(COLS - 1, COLS);
+        return mask;
+    }
+
+    bool test(int r, int c) const { return (*this & field(r, c)).any(); }
+
+    bool any() const {
+        uint64_t bits = 0;
+        for (int k = 0; k != WORDS; ++k)
+            bits |= _w[k];
+        return bits != 0;
+    }
+
+    int count() const {
+        int n = 0;
+        for (int k = 0; k != WORDS; ++k)
+            n += __builtin_popcountll(_w[k]);
+        return n;
+    }
+
+    BasicBoardMask operator|(const BasicBoardMask &other) const {
+        BasicBoardMask result;
+        for (int k = 0; k != WORDS; ++k)
+            result._w[k] = _w[k] | other._w[k];
+        return result;
+    }
+
+    BasicBoardMask operator&(const BasicBoardMask &other) const {
+        BasicBoardMask result;
+        for (int k = 0; k != WORDS; ++k)
+            result._w[k] = _w[k] & other._w[k];
+        return result;
+    }
+
+    BasicBoardMask &operator|=(const BasicBoardMask &other) {
+        for (int k = 0; k != WORDS; ++k)
+            _w[k] |= other._w[k];
+        return *this;
+    }
+
+    /** Fields in this set but not in `other` */
+    BasicBoardMask without(const BasicBoardMask &other) const {
+        BasicBoardMask result;
+        for (int k = 0; k != WORDS; ++k)
+            result._w[k] = _w[k] & ~other._w[k];
+        return result;
+    }
+
+    /** Shifts every field by n bits towards higher indices (-64 < n < 64) */
+    BasicBoardMask shifted(int n) const {
+        BasicBoardMask result;
+        if (n > 0) {
+            for (int k = 0; k != WORDS; ++k)
+                result._w[k] = (_w[k] << n) | (k ? _w[k-1] >> (64 - n) : 0);
+        } else if (n < 0) {
+            for (int k = 0; k != WORDS; ++k) {
+                result._w[k] = (_w[k] >> -n)
+                               | (k + 1 != WORDS ? _w[k+1] << (64 + n) : 0);
+            }
+        } else {
+            result = *this;
+        }
+        return result;
+    }
+
+    /** Fields above, below, left or right of some field in the set */
+    BasicBoardMask neighbours() const {
+        return (shifted(COLS) | shifted(-COLS)
+                | without(right_column()).shifted(1)
+                | without(left_column()).shifted(-1)) & all();
+    }
+
+private:
+    /** All fields in the columns from `first` to before `last` */
+    static BasicBoardMask _columns(int first, int last) {
+        BasicBoardMask mask;
+        for (int r = 0; r != ROWS; ++r) {
+            for (int c = first; c != last; ++c)
+                mask |= field(r, c);
+        }
+        return mask;
+    }
+
+    uint64_t _w[WORDS];
+};
+
+typedef BasicBoardMask<10, 10> BoardMask;
+
+/**
+ * Histogram of latencies in nanoseconds, in the spirit of HdrHistogram: each
+ * power of two is split into 16 buckets, so that every value is kept to
+ * within 1/16, while recording one takes a few instructions and no memory.
+ */
+class LatencyHistogram
+{
+public:
+    enum {
+        SUB_BITS = 4,
+        SUB_COUNT = 1 << SUB_BITS,
+        MAX_BITS = 40,                              // about 18 minutes
+        BUCKETS = SUB_COUNT * (MAX_BITS - SUB_BITS + 1)
+    };
+
+    LatencyHistogram() { clear(); }
+
+    void clear() {
+        std::fill_n(_counts, int(BUCKETS), 0);
+        _total = 0;
+        _max = 0;
+    }
+
+    void record(uint64_t ns) {
+        ns = std::min(ns, (uint64_t(1) << MAX_BITS) - 1);
+        ++_counts[_index(ns)];
+        ++_total;
+        _max = std::max(_max, ns);
+    }
+
+    void merge(const LatencyHistogram &other) {
+        if (other._total == 0)
+            return;
+        for (int i = 0; i != BUCKETS; ++i)
+            _counts[i] += other._counts[i];
+        _total += other._total;
+        _max = std::max(_max, other._max);
+    }
+
+    uint64_t count() const { return _total; }
+
+    uint64_t max() const { return _max; }
+
+    /** Latency that a fraction `q` of the responses did not exceed */
+    uint64_t quantile(double q) const {
+        uint64_t rank = std::max<uint64_t>(1, uint64_t(q * _total + 0.999999));
+        uint64_t seen = 0;
+        for (int i = 0; i != BUCKETS; ++i) {
+            seen += _counts[i];
+            if (seen >= rank)
+                return std::min(_highest(i), _max);
+        }
+        return _max;
+    }
+
+private:
+    static int _index(uint64_t ns) {
+        if (ns < SUB_COUNT)
+            return ns;
+        int bits = 63 - __builtin_clzll(ns);
+        return SUB_COUNT * (bits - SUB_BITS + 1)
+               + ((ns >> (bits - SUB_BITS)) & (SUB_COUNT - 1));
+    }
+
+    /** Largest value that goes into bucket i */
+    static uint64_t _highest(int i) {
+        if (i < SUB_COUNT)
+            return i;
+        int shift = i / SUB_COUNT - 1;
+        return (uint64_t(SUB_COUNT + i % SUB_COUNT + 1) << shift) - 1;
+    }
+
+    uint32_t _counts[BUCKETS];
+    uint64_t _total, _max;
+};
+
+/** How long the referee waited for the lines of a player, by phase */
+struct Latencies
+{
+    enum Phase { PLACEMENT, FIRST_SHOT, SHOTS, NPHASES };
+
+    static const char *phase_name(int phase) {
+        static const char *names[] = {"Platzierung", "erster Schuss",
+                                      "Schuesse"};
+        return names[phase];
+    }
+
+    void clear() {
+        for (int i = 0; i != NPHASES; ++i)
+            phase[i].clear();
+    }
+
+    void merge(const Latencies &other) {
+        for (int i = 0; i != NPHASES; ++i)
+            phase[i].merge(other.phase[i]);
+    }
+
+    /** Prints a line with count, p50, p99 and max in ms for each phase */
+    void print(std::ostream &out, const std::string &label) const {
+        for (int i = 0; i != NPHASES; ++i) {
+            if (phase[i].count() == 0)
+                continue;
+            out << std::left << std::setw(20) << label << std::setw(14)
+                << phase_name(i) << std::right << std::setw(8)
+                << phase[i].count() << std::fixed << std::setprecision(3)
+                << std::setw(10) << phase[i].quantile(0.50) / 1e6
+                << std::setw(10) << phase[i].quantile(0.99) / 1e6
+                << std::setw(10) << phase[i].max() / 1e6 << "\n";
+        }
+    }
+
+    static void print_header(std::ostream &out) {
+        out << "Antwortzeiten [ms]                    Anzahl       p50"
+               "       p99       max\n";
+    }
+
+    LatencyHistogram phase[NPHASES];
+};
+
+/**
+ * Chess clock of a program: `budget_ms` of thinking time for the whole game,
+ * plus `increment_ms` for every line it writes.  Only the time the referee
+ * waits for a line counts, as measured on the monotonic clock.  Programs
+ * whose time runs out lose the game.  With `announce`, a program is sent
+ * its remaining time as a line "Z MILLISEKUNDEN" at the start of the game
+ * and after every outcome of its shots.
+ */
+struct TimeControl
+{
+    TimeControl() : budget_ms(0), increment_ms(0), announce(false) { }
+
+    /** Parses "SEKUNDEN" or "SEKUNDEN+SEKUNDEN"; false if it is invalid */
+    static bool parse(const std::string &text, TimeControl &control) {
+        char *end;
+        double budget = strtod(text.c_str(), &end), increment = 0;
+        if (*end == '+')
+            increment = strtod(end + 1, &end);
+        if (*end != '\0' || !(budget > 0 && budget < 1e6)
+                || !(increment >= 0 && increment < 1e6))
+            return false;
+        control.budget_ms = int(budget * 1000 + 0.5);
+        control.increment_ms = int(increment * 1000 + 0.5);
+        return control.budget_ms > 0;
+    }
+
+    bool enabled() const { return budget_ms > 0; }
+
+    int budget_ms, increment_ms;
+    bool announce;
+};
+
+/** Thrown when a program has used up the time on its clock */
+struct Timeout : std::runtime_error
+{
+    Timeout() : std::runtime_error("Zeit abgelaufen: das Spieler-Programm hat "
+                                   "seine Bedenkzeit ueberschritten") { }
+};
+
+/** Outcomes of a shot, shared by the players of all variants */
+struct ShotOutcome
+{
+    enum Outcome {
+        MISS, HIT, SUNK
+    };
+};
+
+template <typename Rules>
+class BasicPlayer : public ShotOutcome
+{
+public:
+    typedef BasicBoardMask<Rules::rows, Rules::cols> Mask;
+
+    BasicPlayer() : BasicPlayer('x') { }
+
+    BasicPlayer(char which, ChildProcess &&child = ChildProcess())
+        : _which(which)
+        , _child(std::move(child))
+        , _nfleet(1)
+        , _dead(false)
+        , _failed(false)
+        , _pending(Rules::nships + 1)     // the ships and the first shot
+        , _informed(false)
+        , _latencies(nullptr)
+        , _answers(0)
+        , _waiting_since(0)
+        , _clock_ns(0)
+    {
+        std::fill_n(_ship_at, int(Rules::fields), 0);
+    }
+
+    BasicPlayer(char which, PluginBot &&plugin) : BasicPlayer(which) {
+        _plugin = std::move(plugin);
+    }
+
+    BasicPlayer(char which, SocketBot &&remote) : BasicPlayer(which) {
+        _remote = std::move(remote);
+    }
+
+    bool is_machine() const {
+        return _child.started() || _plugin.started() || _remote.started();
+    }
+
+    bool is_plugin() const { return _plugin.started(); }
+
+    /** Whether the player is a game on a bot server */
+    bool is_remote() const { return _remote.started(); }
+
+    void die() { _dead = true; }
+
+    /** Marks an illegal action: the program cannot be trusted any more */
+    void fail() { _failed = true; die(); }
+
+    bool failed() const { return _failed; }
+
+    bool alive() const { return !_dead && _ships.without(_hits).any(); }
+
+    /** Number of ship fields not hit yet */
+    int live() const { return _ships.without(_hits).count(); }
+
+    char which() const { return _which; }
+
+    const ChildProcess &child() const { return _child; }
+
+    ChildProcess &child() { return _child; }
+
+    ChildProcess release_child() { return std::move(_child); }
+
+    /**
+     * Resources the program used in this game, once it is over.  A program
+     * that is not `reused` is stopped first.  Plugins, bot servers and
+     * humans use none of their own.
+     */
+    ResourceUsage take_usage(bool reused) {
+        if (!is_machine() || is_plugin() || is_remote())
+            return ResourceUsage();
+        if (!reused)
+            _child.stop();
+        return _child.take_usage();
+    }
+
+    /**
+     * Records how long each line takes in `latencies` from now on.  Called
+     * as the game begins, so the time for the ships counts from here.
+     */
+    void time_responses(Latencies *latencies) {
+        _latencies = latencies;
+        _waiting_since = latencies ? monotonic_ns() : 0;
+    }
+
+    /** Starts the clock of a program for a new game; humans have none */
+    void start_clock(const TimeControl &control) {
+        if (!control.enabled() || !is_machine())
+            return;
+        _control = control;
+        _clock_ns = int64_t(control.budget_ms) * 1000000;
+        if (!_waiting_since)
+            _waiting_since = monotonic_ns();
+        try {
+            if (_control.announce && is_remote())
+                _remote.send(_clock_line());
+            else if (_control.announce && !is_plugin())
+                _child.send(_clock_line());
+        } catch(const std::runtime_error &e) {
+            // a program that has gone away fails at its first line anyway
+        }
+    }
+
+    /** Stops the clock, e.g. once the game is over */
+    void stop_clock() { _control = TimeControl(); }
+
+    /** Milliseconds left for the line awaited now, or -1 without a clock */
+    int clock_ms() const {
+        if (!_control.enabled())
+            return -1;
+        int64_t left = _clock_ns;
+        if (_waiting_since)
+            left -= monotonic_ns() - _waiting_since;
+        return int(std::max(left, int64_t(0)) / 1000000);
+    }
+
+    /** Returns the next line of the player, valid until the next prompt */
+    LineView prompt() {
+        // Lines are read one after the other here, so the time counts from
+        // the call: from the send, it would include the opponent's turn
+        _waiting_since = 0;
+        uint64_t start = _latencies || _control.enabled() ? monotonic_ns() : 0;
+        LineView line;
+        try {
+            line = _prompt();
+        } catch(const std::runtime_error &e) {
+            // time-outs are the slowest answers
+            if (!_answered(start))
+                throw Timeout();
+            throw;
+        }
+        if (!_answered(start))
+            throw Timeout();
+        return line;
+    }
+
+    /**
+     * Like prompt() for programs, but only takes a line already read by
+     * ChildProcess::fill() and returns false if there is none.  The time
+     * counts from sending the prompt or outcome the line answers, or from
+     * the previous line while the program owes more, until the line arrived.
+     */
+    bool try_prompt(LineView &line) {
+        if (is_plugin()) {
+            line = prompt();
+            return true;
+        }
+        bool complete;
+        try {
+            complete = _try_prompt(line);
+        } catch(const std::runtime_error &e) {
+            give_up();
+            throw;
+        }
+        if (!complete)
+            return false;
+        uint64_t arrived = 0;
+        if (_waiting_since)
+            arrived = std::max(_child.filled_ns(), _waiting_since);
+        bool in_time = _answered(_waiting_since, arrived);
+        _waiting_since = _pending > 0 ? arrived : 0;
+        if (!in_time)
+            throw Timeout();
+        return true;
+    }
+
+    /** The referee stops waiting for a line: books the time waited so far */
+    void give_up() {
+        _answered(_waiting_since);
+        _waiting_since = 0;
+    }
+
+    /** Number of lines the program has yet to write in this game */
+    int pending() const { return _pending; }
+
+    void send(char c) {
+        if (is_machine()) {
+            if (is_plugin()) {
+                _plugin.send(c);
+            } else {
+                char msg[3] = {c, '\n', '\0'};
+                std::string lines(msg);
+                if (_control.announce && c != 'W' && c != 'L' && c != 'U')
+                    lines += _clock_line();
+                if (is_remote())
+                    _remote.send(lines);
+                else
+                    _child.send(lines);
+            }
+            if (c == 'W' || c == 'L') {
+                _informed = true;
+            } else {
+                ++_pending;
+                if (_latencies || _control.enabled())
+                    _waiting_since = monotonic_ns();
+            }
+        } else {
+            std::cout << c << std::endl;
+        }
+    }
+
+    void check_valid(int r, int c) const {
+        if (r < 0 || r >= Rules::rows)
+            throw std::runtime_error("Ungueltige Zeile");
+        if (c < 0 || c >= Rules::cols)
+            throw std::runtime_error("Ungueltige Spalte");
+        if (r != 0 && board(r-1, c) != ' ')
+            throw std::runtime_error("Schiff beruehrt oben anderes Schiff");
+        if (r != Rules::rows - 1 && board(r+1, c) != ' ')
+            throw std::runtime_error("Schiff beruehrt unten anderes Schiff");
+        if (c != 0 && board(r, c-1) != ' ')
+            throw std::runtime_error("Schiff beruehrt links anderes Schiff");
+        if (c != Rules::cols - 1 && board(r, c+1) != ' ')
+            throw std::runtime_error("Schiff beruehrt rechts anderes Schiff");
+    }
+
+    char board(int r, int c) const {
+        if (_ships.test(r, c))
+            return _hits.test(r, c) ? 'X' : 'S';
+        return _misses.test(r, c) ? 'o' : ' ';
+    }
+
+    /** Length of the ship to be placed next, 0 once all are placed */
+    int next_ship_size() const {
+        int placed = _nfleet - 1;
+        return placed < Rules::nships ? Rules::ship_sizes[placed] : 0;
+    }
+
+    void place(int r, int c, int size, bool downward) {
+        if (size <= 0 || size > _largest_ship() || _nfleet > Rules::nships)
+            throw std::runtime_error("Ungueltige Groesse");
+        if (downward && r > Rules::rows - size)
+            throw std::runtime_error("Schiff hat nach unten nicht Platz.");
+        if (!downward && c > Rules::cols - size)
+            throw std::runtime_error("Schiff hat nach rechts nicht Platz.");
+
+        int dr = downward ? 1 : 0, dc = downward ? 0 : 1;
+        bool inside = r >= 0 && c >= 0
+                      && r + dr * (size - 1) < Rules::rows
+                      && c + dc * (size - 1) < Rules::cols;
+        if (!inside || (_shape(r, c, size, downward).neighbours
+                        & (_ships | _misses)).any()) {
+            // Something is wrong: find out what to tell the player
+            for (int k = 0; k != size; ++k)
+                check_valid(r + dr * k, c + dc * k);
+        }
+
+        const Mask &ship = _shape(r, c, size, downward).ship;
+        for (int k = 0; k != size; ++k)
+            _ship_at[Rules::cols * (r + dr * k) + c + dc * k] = _nfleet;
+        _fleet[_nfleet++] = ship;
+        _ships |= ship;
+    }
+
+    /**
+     * Ends the game for a multi-game program, which is told the result
+     * (`W`, `L` or `U` for a draw) unless it already knows.  Lines it wrote
+     * in the meantime are discarded.  Returns whether the program can be
+     * reused for another game.  Plugins and bot servers are told the result,
+     * too, but get a fresh game instead of being reused.
+     */
+    bool conclude(char result) {
+        if (is_plugin() && !_failed && !_informed)
+            _plugin.send(result);
+        if (is_remote() && !_failed && !_informed) {
+            try {
+                send(result);
+            } catch(const std::runtime_error &e) {
+                // the server is gone; it does not need to know
+            }
+        }
+        if (_failed || _child.protocol() != ChildProcess::MULTI_GAME)
+            return false;
+        try {
+            for (; _pending > 0; --_pending)
+                _child.getline();
+            if (!_informed)
+                send(result);
+        } catch(const std::runtime_error &e) {
+            return false;
+        }
+        return true;
+    }
+
+    Outcome incoming(int r, int c) {
+        if (r < 0 || r >= Rules::rows)
+            throw std::runtime_error("Ungueltige Zeile");
+        if (c < 0 || c >= Rules::cols)
+            throw std::runtime_error("Ungueltige Spalte");
+
+        Mask target = Mask::field(r, c);
+        bool hit = (_ships & target).without(_hits).any();
+        _hits |= _ships & target;
+        _misses |= target.without(_ships);
+
+        // Fields without ship refer to an empty ship, which is always sunk
+        const Mask &ship = _fleet[_ship_at[Rules::cols * r + c]];
+        bool sunk = !ship.without(_hits).any();
+        return Outcome(hit + (hit & sunk));
+    }
+
+private:
+    /** The fields of a ship and those around it */
+    struct Shape {
+        Mask ship, neighbours;
+    };
+
+    static int _largest_ship() {
+        return *std::max_element(Rules::ship_sizes,
+                                 Rules::ship_sizes + Rules::nships);
+    }
+
+    /**
+     * Shape of the ship at (r, c) that fits on the board, looked up in a
+     * table with every ship on every field, which is built on first use.
+     */
+    static const Shape &_shape(int r, int c, int size, bool downward) {
+        static const std::vector<Shape> shapes = _shapes();
+        return shapes[(2 * (size - 1) + downward) * Rules::fields
+                      + Rules::cols * r + c];
+    }
+
+    static std::vector<Shape> _shapes() {
+        std::vector<Shape> shapes(2 * _largest_ship() * Rules::fields);
+        for (int size = 1; size <= _largest_ship(); ++size) {
+            for (int downward = 0; downward != 2; ++downward) {
+                int dr = downward, dc = 1 - downward;
+                for (int r = 0; r <= Rules::rows - 1 - dr * (size - 1); ++r) {
+                    for (int c = 0; c <= Rules::cols - 1 - dc * (size - 1); ++c) {
+                        Shape &shape = shapes[(2 * (size - 1) + downward)
+                                              * Rules::fields
+                                              + Rules::cols * r + c];
+                        for (int k = 0; k != size; ++k)
+                            shape.ship |= Mask::field(r + dr * k, c + dc * k);
+                        shape.neighbours = shape.ship.neighbours();
+                    }
+                }
+            }
+        }
+        return shapes;
+    }
+
+    LineView _prompt() {
+        if (is_plugin()) {
+            --_pending;
+            return _plugin.getline();
+        } else if (is_remote()) {
+            LineView line = _remote.getline(clock_ms() < 0 ? 2000
+                                                           : clock_ms() + 1);
+            --_pending;
+            return line;
+        } else if (is_machine()) {
+            int timeout = clock_ms() < 0 ? 2000 : clock_ms() + 1;
+            LineView line = _child.getline(200, timeout);
+            while (_is_greeting(line))
+                line = _child.getline(200, timeout);
+            --_pending;
+            return line;
+        } else {
+            if (!getline(std::cin, _typed)) {
+                std::cerr << "Aborted by user\n";
+                exit(96);
+            }
+            return LineView(_typed);
+        }
+    }
+
+    bool _try_prompt(LineView &line) {
+        do {
+            if (!_child.try_getline(line))
+                return false;
+        } while (_is_greeting(line));
+        --_pending;
+        return true;
+    }
+
+    /**
+     * Books the time from `start` (0 if there was no wait) to `stop`, by
+     * default now, to its phase and to the clock.  Returns false if the
+     * clock has run out.
+     */
+    bool _answered(uint64_t start, uint64_t stop = 0) {
+        int phase = _answers < Rules::nships ? Latencies::PLACEMENT
+                  : _answers == Rules::nships ? Latencies::FIRST_SHOT
+                  : Latencies::SHOTS;
+        ++_answers;
+        uint64_t waited = start ? (stop ? stop : monotonic_ns()) - start : 0;
+        if (_latencies)
+            _latencies->phase[phase].record(waited);
+        if (!_control.enabled())
+            return true;
+        _clock_ns -= waited;
+        if (_clock_ns < 0)
+            return false;
+        _clock_ns += int64_t(_control.increment_ms) * 1000000;
+        return true;
+    }
+
+    std::string _clock_line() const {
+        return "Z " + std::to_string(_clock_ns / 1000000) + "\n";
+    }
+
+    /**
+     * Handles the first lines of a program, which may be greetings.  Other
+     * variants than the standard one need the greeting "VARIANTE" first.
+     */
+    bool _is_greeting(const LineView &line) {
+        if (_child.protocol() != ChildProcess::UNKNOWN)
+            return false;
+        if (line == "VARIANTE\n" && !_child.knows_variant()) {
+            _child.set_knows_variant();
+            return true;
+        }
+        if (!std::is_same<Rules, Standard>::value && !_child.knows_variant()) {
+            throw std::runtime_error(
+                    "Das Spieler-Programm kennt keine Varianten (es hat "
+                    "nicht zuerst die Zeile VARIANTE geschrieben).");
+        }
+        if (line == "MULTI\n") {
+            _child.set_protocol(ChildProcess::MULTI_GAME);
+            return true;
+        }
+        _child.set_protocol(ChildProcess::SINGLE_GAME);
+        return false;
+    }
+
+    char _which;
+    ChildProcess _child;
+    PluginBot _plugin;
+    SocketBot _remote;
+    std::string _typed;             // last line typed by a human
+    Mask _ships, _hits, _misses;
+    Mask _fleet[Rules::nships + 1];         // 0 is the empty ship
+    int _nfleet;                            // ships in _fleet, with 0
+    unsigned char _ship_at[Rules::fields];  // index into _fleet, 0 if no ship
+    bool _dead;
+    bool _failed;
+    int _pending;   // lines the program owes us
+    bool _informed;
+    Latencies *_latencies;
+    int _answers;
+    uint64_t _waiting_since;
+    TimeControl _control;
+    int64_t _clock_ns;      // time left on the clock
+};
+
+typedef BasicPlayer<Standard> Player;
+
+void print_usage(std::string name)
+{
+    std::cerr << "Schiffe versenken v" << VERSION << ". Verwendung:\n\n"
+              << "    " << name << " [--leise] [--aufzeichnung DATEI] "
+                 "SPIELER_A SPIELER_B\n"
+              << "    " << name << " --turnier [OPTIONEN] PROGRAMM...\n"
+              << "    " << name << " --duell [OPTIONEN] KANDIDAT CHAMPION\n"
+              << "    " << name << " --wiedergabe [FILTER] DATEI\n\n"
+              << "Fuer SPIELER_A oder SPIELER_B kann eingesetzt werden:\n\n"
+              << "    - 'mensch': Spieler spielt ueber die Tastatur\n"
+              << "    - './PROGRAMMNAME': Spieler ist ein Programm\n"
+              << "    - 'lib:./BIBLIOTHEK.so': Spieler ist ein Plugin "
+                 "(siehe spieler_plugin.h)\n"
+              << "    - 'unix:/PFAD/ZUM/SOCKET': Spieler ist ein laufender "
+                 "Bot-Server\n      (siehe bot_server.cpp)\n\n"
+              << "Im Turnier spielt jedes PROGRAMM gegen jedes andere. "
+                 "OPTIONEN sind:\n\n"
+              << "    -n SPIELE     Spiele pro Paarung (Standard: 2)\n"
+              << "    -j THREADS    gleichzeitige Spiele (Standard: Anzahl "
+                 "der Prozessoren)\n"
+              << "    --gauntlet    nur das erste PROGRAMM spielt gegen alle "
+                 "anderen\n"
+              << "    --epoll       alle Spiele in einem Thread; -j gibt dann "
+                 "die Anzahl\n"
+              << "                  gleichzeitiger Spiele an (Standard: 64)\n"
+              << "    --leise       jedes Spiel als JSON-Zeile auf die "
+                 "Standardausgabe,\n"
+              << "                  die Tabelle auf die Fehlerausgabe\n"
+              << "    --aufzeichnung DATEI\n"
+              << "                  jedes Spiel binaer an DATEI anhaengen\n"
+              << "    --vorstart N  N Prozesse jedes Programms im Voraus "
+                 "starten, damit\n"
+              << "                  kein Spiel auf den Programmstart wartet\n"
+              << "    --ergebnisse DATEI\n"
+              << "                  Ergebnisse in DATEI speichern und nur "
+                 "Paarungen spielen,\n"
+              << "                  in denen sich ein Programm seit dem "
+                 "letzten Turnier\n"
+              << "                  geaendert hat\n"
+              << "    --metriken DATEI\n"
+              << "                  alle 5 Sekunden Spiele, Zuege, Fehler und "
+                 "Startzeiten\n"
+              << "                  im Textformat von Prometheus nach DATEI "
+                 "schreiben\n\n"
+              << "Im Duell spielt KANDIDAT gegen CHAMPION, bis ein "
+                 "sequentieller Test\n(SPRT) entscheidet, ob KANDIDAT "
+                 "staerker ist (Rueckgabewert 0) oder\nnicht (1); ohne "
+                 "Entscheidung ist er 2.  Neben -j, --leise,\n"
+                 "--aufzeichnung und --vorstart wie im Turnier sind "
+                 "OPTIONEN:\n\n"
+              << "    -n SPIELE     hoechstens so viele Spiele (Standard: "
+                 "20000)\n"
+              << "    --elo0 ELO    KANDIDAT ist um ELO staerker unter H0 "
+                 "(Standard: 0)\n"
+              << "    --elo1 ELO    ... und unter H1 (Standard: 10)\n"
+              << "    --alpha P     Wahrscheinlichkeit, H1 irrtuemlich "
+                 "anzunehmen (0.05)\n"
+              << "    --beta P      Wahrscheinlichkeit, H0 irrtuemlich "
+                 "anzunehmen (0.05)\n\n"
+              << "Mit --leise wird auch ein einzelnes Spiel nicht angezeigt, "
+                 "sondern als\nJSON-Zeile ausgegeben.\n\n"
+              << "Mit --zeit SEKUNDEN[+SEKUNDEN] spielen Programme mit "
+                 "Schachuhr: jedes hat\nso viel Bedenkzeit fuer das ganze "
+                 "Spiel, plus die zweite Zahl fuer\njede Zeile, die es "
+                 "schreibt; wessen Zeit ablaeuft, verliert. Mit\n--restzeit "
+                 "bekommt jedes Programm zu Beginn und nach jedem Ergebnis "
+                 "eine\nZeile 'Z MILLISEKUNDEN' mit seiner Restzeit.\n\n"
+              << "Mit --cpu-grenze SEKUNDEN und --speicher-grenze MB darf "
+                 "jedes Programm\nhoechstens so viel CPU-Zeit je Spiel bzw. "
+                 "Speicher verbrauchen; ein Programm,\ndas mehrere Spiele "
+                 "spielt, bekommt die CPU-Zeit fuer jedes Spiel neu.  Wie "
+                 "viel\nes verbraucht hat, steht "
+                 "nach jedem Spiel und Turnier in der Tabelle\n'Ressourcen' "
+                 "bzw. unter \"ressourcen\" in der JSON-Zeile.\n\n"
+              << "Mit --shm wird jedem Programm gemeinsamer Speicher "
+                 "angeboten, ueber den es\nschneller als ueber stdin und "
+                 "stdout spielt (siehe spieler_shm.h); Programme,\ndie "
+                 "nichts davon wissen, spielen weiter ueber stdin und "
+                 "stdout.  Nicht\nmit --epoll.\n\n"
+              << "Mit --variante VARIANTE wird statt des Standardspiels "
+                 "(standard) eine\nVariante gespielt; --epoll, "
+                 "--aufzeichnung und die Wiedergabe gibt es\nnur im "
+                 "Standardspiel. Die Schiffe werden in dieser Reihenfolge "
+                 "gesetzt:\n\n"
+              << "    standard      10x10 Felder, Schiffe 4-4-4-4, 100 Zuege\n"
+              << "    gemischt      10x10 Felder, Schiffe 5-4-3-3-2, "
+                 "100 Zuege\n"
+              << "    gross         15x15 Felder, Schiffe 5-4-4-3-3-2, "
+                 "225 Zuege\n\n"
+              << "Programme, Plugins und Bot-Server muessen die Variante "
+                 "kennen (siehe\nspieler_programm.cpp und "
+                 "spieler_plugin.h).\n\n"
+              << "Die Wiedergabe listet die aufgezeichneten Spiele. FILTER "
+                 "sind:\n\n"
+              << "    --programm PROGRAMM   nur Spiele dieses Programms\n"
+              << "    --ergebnis 0|1|2      nur unentschieden, Siege von A "
+                 "bzw. B\n"
+              << "    --grund GRUND         versenkt, zuglimit, "
+                 "illegale_platzierung,\n"
+              << "                          illegale_aktion oder zeit\n"
+              << "    --spiel NUMMER        nur das Spiel mit dieser Nummer\n"
+              << "    --zeigen              Endstand der Spiele zeichnen\n\n"
+              << "Mit --wertung DATEI werden im Turnier und im Duell nach "
+                 "jedem Spiel die\nElo- und TrueSkill-Wertungen in DATEI "
+                 "weitergefuehrt.  Die Wiedergabe\nberechnet sie stattdessen "
+                 "aus allen Spielen, die den FILTERn entsprechen,\nneu und "
+                 "schreibt sie nach DATEI.\n";
+}
+
+template <typename Rules>
+BasicPlayer<Rules> make_player(std::string spec, char which,
+                               std::ostream &out=std::cerr)
+{
+    out << "Spieler " << which;
+    if (spec == "mensch") {
+        out << " ist ein Mensch ...\n";
+        return BasicPlayer<Rules>(which);
+    }
+    if (PluginBot::is_spec(spec)) {
+        out << " ist das Plugin `" << spec.substr(4) << "', lade dieses ...\n";
+        return BasicPlayer<Rules>(which,
+                                  PluginBot(spec, GameVariant::of<Rules>()));
+    }
+    if (SocketBot::is_spec(spec)) {
+        out << " spielt auf dem Bot-Server `" << spec.substr(5)
+            << "', verbinde ...\n";
+        return BasicPlayer<Rules>(which,
+                                  SocketBot(spec, GameVariant::of<Rules>()));
+    }
+    if (spec.find('/') == std::string::npos) {
+        throw std::runtime_error(
+                "Programm '" + spec + "' muss ausfuehrbarer Pfad sein.\n"
+                "(Vielleicht ist ./" + spec + " gemeint?)\n");
+    }
+    out << " ist das Programm `" << spec << "', starte dieses ...\n";
+    return BasicPlayer<Rules>(which, ChildProcess(spec));
+}
+
+/**
+ * Draws line `row` of the board of `player`: a header, a separator, the rows
+ * of the board, a separator and a header again.  Boards with more than ten
+ * rows or columns get wider labels or fields.
+ */
+template <typename Rules>
+void print_board(std::ostream &out, const BasicPlayer<Rules> &player,
+                 bool visible, int row)
+{
+    const int label = Rules::rows > 10 ? 2 : 1;
+    const int width = Rules::cols > 10 ? 2 : 1;
+
+    if (row == 0 || row == Rules::rows + 3) {
+        out << std::setw(label) << player.which() << " | ";
+        for (int c = 0; c != Rules::cols; ++c)
+            out << std::setw(width) << c << ' ';
+        out << "| " << std::left << std::setw(label) << player.which()
+            << std::right;
+    } else if (row == 1 || row == Rules::rows + 2) {
+        out << std::string(label + 1, '-') << '+'
+            << std::string((width + 1) * Rules::cols + 1, '-') << '+'
+            << std::string(label + 1, '-');
+    } else if (row <= Rules::rows + 1) {
+        row -= 2;
+        out << std::setw(label) << row << " | ";
+        for (int c = 0; c != Rules::cols; ++c) {
+            char field = player.board(row, c);
+            if (!visible && field != 'o' && field != 'X')
+                field = ' ';
+            out << std::setw(width) << (field == ' ' ? '.' : field) << ' ';
+        }
+        out << "| " << std::left << std::setw(label) << row << std::right;
+    }
+}
+
+template <typename Rules>
+void print_boards(std::ostream &out, const BasicPlayer<Rules> &me,
+                  const BasicPlayer<Rules> &other, bool other_visible)
+{
+    out << "\n";
+    for (int r = 0; r != Rules::rows + 4; ++r) {
+        out << "        ";
+        print_board(out, me, true, r);
+        out << "          ";
+        print_board(out, other, other_visible, r);
+        out << "\n";
+    }
+    out << std::endl;
+}
+
+/**
+ * A game in the fixed-width binary format of record files (--aufzeichnung),
+ * so that a file of records can be mapped into memory and indexed directly.
+ *
+ * Ships are stored as field 10*zeile+spalte, plus 100 if pointing downward.
+ * Shots are stored as field and outcome (Player::Outcome), plus SHOT_BY_B if
+ * B fired it.  Names of programs are cut to 39 characters.  Only games of
+ * the standard variant are recorded.
+ */
+struct GameRecord
+{
+    enum {
+        SPEC_SIZE = 40,
+        MAX_SHOTS = 2 * Standard::max_moves,
+        SHOT_BY_B = 4,
+        DOWNWARD = Standard::fields         // added to the field of a ship
+    };
+
+    char magic[4];                          // "SVR1"
+    uint8_t result;                         // 1: A won, 2: B won, 0: draw
+    uint8_t reason;                         // GameLog::Reason
+    uint8_t nships[2];                      // ships placed by A and B
+    uint8_t nshots;
+    uint8_t reserved[7];
+    char spec[2][SPEC_SIZE];                // zero-padded
+    uint8_t ships[2][Standard::nships];
+    uint8_t shot_field[MAX_SHOTS];
+    uint8_t shot_outcome[MAX_SHOTS];
+    uint8_t padding[8];
+
+    static const char *magic_bytes() { return "SVR1"; }
+
+    bool valid() const { return memcmp(magic, magic_bytes(), 4) == 0; }
+
+    /** Whether `spec` is one of the players, as far as the name was kept */
+    bool plays(const std::string &spec_name) const {
+        for (int which = 0; which != 2; ++which) {
+            if (strncmp(spec[which], spec_name.c_str(), SPEC_SIZE - 1) == 0)
+                return true;
+        }
+        return false;
+    }
+};
+
+static_assert(sizeof(GameRecord) == 512, "GameRecord must be 512 bytes");
+static_assert(Standard::nships == 4 && Standard::max_moves == 100
+              && Standard::rows == 10 && Standard::cols == 10,
+              "record files hold games of the standard variant: a change to "
+              "it needs a new format (magic) for GameRecord");
+
+/**
+ * Record of a game for headless runs.  Instead of rendering the game as it
+ * goes, the moves are collected in a fixed array, and the whole game is
+ * written as a single JSON line once it is over:
+ *
+ *     {"a":"./x","b":"./y","ergebnis":1,"grund":"versenkt","zuege":37,
+ *      "schiffe":["A00R",...],"schuesse":["A34F","B00T",...]}
+ *
+ * "ergebnis" is the exit code of a single game, "grund" one of "versenkt",
+ * "zuglimit", "illegale_platzierung", "illegale_aktion" or "zeit" (the clock
+ * ran out, see TimeControl); in the latter three cases, "fehler" holds the
+ * message.  The shots are listed as shooter, row,
+ * column and outcome ('F' miss, 'T' hit, 'V' sunk).  Finally, "zeiten_ns"
+ * holds p50, p99 and max of the response times of each player by phase, and
+ * "ressourcen" the CPU time (user, sys), peak memory and context switches
+ * (voluntary, involuntary) of each player that is a program.
+ *
+ * Games of other variants than the standard one name it in "variante", e.g.
+ * "15x15 5-4-4-3-3-2"; on boards of more than ten rows or columns, rows and
+ * columns are written with two digits each.
+ */
+class GameLog
+{
+public:
+    enum { MAX_EVENTS = 2 * (MAX_SHIPS + MAX_FIELDS) };
+
+    enum Reason {
+        SUNK, MOVE_LIMIT, ILLEGAL_PLACEMENT, ILLEGAL_ACTION, OUT_OF_TIME,
+        NREASONS
+    };
+
+    static const char *reason_name(int reason) {
+        static const char *names[] = {"versenkt", "zuglimit",
+                                      "illegale_platzierung", "illegale_aktion",
+                                      "zeit"};
+        return reason >= 0 && reason < NREASONS ? names[reason] : "?";
+    }
+
+    GameLog() : _nships(Standard::nships), _wide(false) { clear(); }
+
+    /** Sets the variant of the games logged from now on */
+    template <typename Rules>
+    void variant() {
+        if (std::is_same<Rules, Standard>::value)
+            _variant.clear();
+        else
+            _variant = Rules::describe();
+        _nships = Rules::nships;
+        _wide = Rules::rows > 10 || Rules::cols > 10;
+    }
+
+    /** Forgets the last game, keeping the memory for the next one */
+    void clear() {
+        _nevents = 0;
+        _nplaced = 0;
+        _nshots = 0;
+        _failed = 0;
+        _out_of_time = false;
+        _move_limit = false;
+        _error.clear();
+        _latencies[0].clear();
+        _latencies[1].clear();
+        _usage[0] = _usage[1] = ResourceUsage();
+    }
+
+    /** Response times of player A (0) or B (1) in this game */
+    Latencies &latencies(int which) { return _latencies[which]; }
+
+    /** Resources used by the program of player A (0) or B (1) in this game */
+    ResourceUsage &usage(int which) { return _usage[which]; }
+
+    void placement(char which, int r, int c, bool down) {
+        _record(which, r, c, down ? 'U' : 'R');
+        ++_nplaced;
+    }
+
+    void shot(char which, int r, int c, ShotOutcome::Outcome outcome) {
+        static const char outcomechar[] = {'F', 'T', 'V'};
+        _record(which, r, c, outcomechar[outcome]);
+        ++_nshots;
+    }
+
+    /** Player `which` made an illegal move or ran out of time */
+    void failure(char which, const std::runtime_error &error) {
+        _failed = which;
+        _error = error.what();
+        _out_of_time = dynamic_cast<const Timeout *>(&error) != nullptr;
+    }
+
+    /** The game was declared a draw after 100 moves */
+    void move_limit() { _move_limit = true; }
+
+    /** Shots of both players so far */
+    int shots() const { return _nshots; }
+
+    /** Player that made an illegal move or ran out of time, or 0 */
+    char failed() const { return _failed; }
+
+    /** Writes the game as one line and flushes `out` */
+    void write(std::ostream &out, const std::string &spec_a,
+               const std::string &spec_b, int result) {
+        if (_line.capacity() < 4096)
+            _line.reserve(4096);
+        _line = "{\"a\":";
+        _append_string(spec_a);
+        _line += ",\"b\":";
+        _append_string(spec_b);
+        if (!_variant.empty()) {
+            _line += ",\"variante\":";
+            _append_string(_variant);
+        }
+        _line += ",\"ergebnis\":";
+        _line += char('0' + result);
+        _line += ",\"grund\":\"";
+        _line += reason_name(reason());
+        _line += "\",\"zuege\":";
+        _line += std::to_string((_nshots + 1) / 2);
+        if (_failed) {
+            _line += ",\"fehler\":";
+            _append_string(_error);
+        }
+        for (int kind = 0; kind != 2; ++kind) {
+            _line += kind == 0 ? ",\"schiffe\":[" : "],\"schuesse\":[";
+            bool first = true;
+            for (size_t k = 0; k != _nevents; ++k) {
+                const Event &event = _events[k];
+                if ((event.what == 'U' || event.what == 'R') != (kind == 0))
+                    continue;
+                if (!first)
+                    _line += ',';
+                first = false;
+                if (_wide) {
+                    const char token[] = {'"', event.which,
+                                          char('0' + event.row / 10),
+                                          char('0' + event.row % 10),
+                                          char('0' + event.col / 10),
+                                          char('0' + event.col % 10),
+                                          event.what, '"'};
+                    _line.append(token, sizeof(token));
+                } else {
+                    const char token[] = {'"', event.which,
+                                          char('0' + event.row),
+                                          char('0' + event.col),
+                                          event.what, '"'};
+                    _line.append(token, sizeof(token));
+                }
+            }
+        }
+        _line += "],\"zeiten_ns\":{";
+        for (int which = 0; which != 2; ++which) {
+            _line += which == 0 ? "\"A\":{" : "},\"B\":{";
+            bool first = true;
+            for (int i = 0; i != Latencies::NPHASES; ++i) {
+                const LatencyHistogram &phase = _latencies[which].phase[i];
+                if (phase.count() == 0)
+                    continue;
+                _line += first ? "\"" : ",\"";
+                _line += _phase_key(i);
+                _line += "\":[" + std::to_string(phase.quantile(0.50)) + ","
+                         + std::to_string(phase.quantile(0.99)) + ","
+                         + std::to_string(phase.max()) + "]";
+                first = false;
+            }
+        }
+        _line += "}}";
+        if (_usage[0].games || _usage[1].games) {
+            _line += ",\"ressourcen\":{";
+            bool first = true;
+            for (int which = 0; which != 2; ++which) {
+                const ResourceUsage &usage = _usage[which];
+                if (!usage.games)
+                    continue;
+                _line += first ? "\"" : ",\"";
+                _line += char('A' + which);
+                _line += "\":{\"cpu_ns\":[" + std::to_string(usage.user_ns) + ","
+                         + std::to_string(usage.sys_ns) + "],\"max_rss_kb\":"
+                         + std::to_string(usage.max_rss_kb)
+                         + ",\"kontextwechsel\":["
+                         + std::to_string(usage.voluntary) + ","
+                         + std::to_string(usage.involuntary) + "]}";
+                first = false;
+            }
+            _line += "}";
+        }
+        _line += "}\n";
+        out.write(_line.data(), _line.size());
+        out.flush();
+    }
+
+    /** Stores the game in the binary format of record files */
+    void fill(GameRecord &record, const std::string &spec_a,
+              const std::string &spec_b, int result) const {
+        memset(&record, 0, sizeof(record));
+        memcpy(record.magic, GameRecord::magic_bytes(), 4);
+        record.result = result;
+        record.reason = reason();
+        strncpy(record.spec[0], spec_a.c_str(), GameRecord::SPEC_SIZE - 1);
+        strncpy(record.spec[1], spec_b.c_str(), GameRecord::SPEC_SIZE - 1);
+        for (size_t k = 0; k != _nevents; ++k) {
+            const Event &event = _events[k];
+            int field = Standard::cols * event.row + event.col;
+            int by_b = event.which == 'B';
+            if (event.what == 'U' || event.what == 'R') {
+                record.ships[by_b][record.nships[by_b]++] = field
+                        + (event.what == 'U' ? GameRecord::DOWNWARD : 0);
+            } else {
+                record.shot_field[record.nshots] = field;
+                record.shot_outcome[record.nshots++] =
+                                    (event.what == 'F' ? Player::MISS :
+                                     event.what == 'T' ? Player::HIT :
+                                     Player::SUNK)
+                                    + (by_b ? GameRecord::SHOT_BY_B : 0);
+            }
+        }
+    }
+
+    Reason reason() const {
+        if (_out_of_time)
+            return OUT_OF_TIME;
+        if (_failed)
+            return _nplaced != 2 * _nships ? ILLEGAL_PLACEMENT : ILLEGAL_ACTION;
+        return _move_limit ? MOVE_LIMIT : SUNK;
+    }
+
+private:
+    struct Event { char which, row, col, what; };
+
+    static const char *_phase_key(int phase) {
+        static const char *keys[] = {"platzierung", "erster_schuss",
+                                     "schuesse"};
+        return keys[phase];
+    }
+
+    void _record(char which, int r, int c, char what) {
+        if (_nevents != MAX_EVENTS) {
+            Event &event = _events[_nevents++];
+            event.which = which;
+            event.row = r;
+            event.col = c;
+            event.what = what;
+        }
+    }
+
+    void _append_string(const std::string &str) {
+        static const char hex[] = "0123456789abcdef";
+        _line += '"';
+        for (size_t k = 0; k != str.size(); ++k) {
+            unsigned char c = str[k];
+            if (c == '"' || c == '\\') {
+                _line += '\\';
+                _line += c;
+            } else if (c == '\n') {
+                _line += "\\n";
+            } else if (c < 0x20) {
+                _line += "\\u00";
+                _line += hex[c >> 4];
+                _line += hex[c & 15];
+            } else {
+                _line += c;
+            }
+        }
+        _line += '"';
+    }
+
+    Event _events[MAX_EVENTS];
+    size_t _nevents;
+    int _nships, _nplaced, _nshots;
+    bool _wide;
+    std::string _variant;
+    char _failed;
+    bool _out_of_time;
+    bool _move_limit;
+    std::string _error, _line;
+    Latencies _latencies[2];
+    ResourceUsage _usage[2];
+};
+
+/** Appends games to a record file; may be shared between threads */
+class RecordWriter
+{
+public:
+    RecordWriter(const std::string &path)
+        : _fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                     0644))
+    {
+        if (_fd < 0) {
+            throw std::runtime_error("Kann Aufzeichnung '" + path +
+                                     "' nicht oeffnen: " + strerror(errno));
+        }
+    }
+
+    ~RecordWriter() { ::close(_fd); }
+
+    /** A record is a single write(), so records never interleave */
+    void append(const GameRecord &record) {
+        monitored(::write(_fd, &record, sizeof(record)));
+    }
+
+private:
+    RecordWriter(const RecordWriter &) = delete;
+    RecordWriter &operator=(const RecordWriter &) = delete;
+
+    int _fd;
+};
+
+/**
+ * A record file mapped into memory, so that even millions of games can be
+ * gone through without reading them in.  An incomplete record at the end,
+ * e.g., from a referee that was killed while writing, is ignored.
+ */
+class RecordReader
+{
+public:
+    RecordReader(const std::string &path) : _records(nullptr), _size(0) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info;
+        if (fd < 0 || fstat(fd, &info) < 0) {
+            std::string error = strerror(errno);
+            if (fd >= 0)
+                ::close(fd);
+            throw std::runtime_error("Kann Aufzeichnung '" + path +
+                                     "' nicht lesen: " + error);
+        }
+
+        _size = info.st_size / sizeof(GameRecord);
+        void *data = MAP_FAILED;
+        if (_size != 0)
+            data = mmap(nullptr, _bytes(), PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (_size != 0 && data == MAP_FAILED) {
+            throw std::runtime_error("Kann Aufzeichnung '" + path +
+                                     "' nicht lesen: " + strerror(errno));
+        }
+        if (_size != 0) {
+            monitored(madvise(data, _bytes(), MADV_SEQUENTIAL));
+            _records = static_cast<const GameRecord *>(data);
+        }
+    }
+
+    ~RecordReader() {
+        if (_records)
+            munmap(const_cast<GameRecord *>(_records), _bytes());
+    }
+
+    size_t size() const { return _size; }
+
+    const GameRecord &operator[](size_t i) const { return _records[i]; }
+
+private:
+    RecordReader(const RecordReader &) = delete;
+    RecordReader &operator=(const RecordReader &) = delete;
+
+    size_t _bytes() const { return _size * sizeof(GameRecord); }
+
+    const GameRecord *_records;
+    size_t _size;
+};
+
+/**
+ * Ratings of programs, updated game by game as results come in: Elo, and a
+ * TrueSkill rating (mean `mu` and uncertainty `sigma` of the skill) for two
+ * players with draws.  The order of the games matters for both, so replaying
+ * the same results in the same order gives the same ratings.
+ *
+ * Programs are known by their name as kept in a GameRecord, so that ratings
+ * rebuilt from record files match those computed as the games were played.
+ * A snapshot has a line "SPIELE ELO MU SIGMA PROGRAMM" per program.
+ */
+class Ratings
+{
+public:
+    struct Rating {
+        Rating(const std::string &spec)
+            : spec(spec), games(0), elo(INITIAL_ELO), mu(INITIAL_MU),
+              sigma(INITIAL_MU / 3) { }
+
+        /** Skill the program has with high probability, to rank by */
+        double conservative() const { return mu - 3 * sigma; }
+
+        std::string spec;
+        long games;
+        double elo, mu, sigma;
+    };
+
+    static constexpr double INITIAL_ELO = 1500, ELO_K = 16;
+
+    /**
+     * TrueSkill parameters as usual: the performance in a game scatters by
+     * BETA around the skill, which drifts by TAU per game.  DRAW_MARGIN
+     * makes one game in ten a draw between equal players.
+     */
+    static constexpr double INITIAL_MU = 25, BETA = INITIAL_MU / 6,
+                            TAU = INITIAL_MU / 300, DRAW_MARGIN = 0.7404;
+
+    Ratings() { }
+
+    /** Rates a game of `spec_a` against `spec_b` with play_game()'s result */
+    void add(const std::string &spec_a, const std::string &spec_b,
+             int result) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t a = _index_of(spec_a.c_str(), spec_a.size());
+        size_t b = _index_of(spec_b.c_str(), spec_b.size());
+        _add(_ratings[a], _ratings[b], result);
+    }
+
+    /** Same for a recorded game */
+    void add(const GameRecord &record) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        size_t a = _index_of(record.spec[0], strnlen(record.spec[0],
+                                                     GameRecord::SPEC_SIZE));
+        size_t b = _index_of(record.spec[1], strnlen(record.spec[1],
+                                                     GameRecord::SPEC_SIZE));
+        _add(_ratings[a], _ratings[b], record.result);
+    }
+
+    size_t size() const { return _ratings.size(); }
+
+    const Rating &operator[](size_t i) const { return _ratings[i]; }
+
+    /** Loads a snapshot; if there is no such file, starts without ratings */
+    void load(const std::string &path) {
+        std::ifstream in(path.c_str());
+        if (!in)
+            return;
+        Rating rating("");
+        while (in >> rating.games >> rating.elo >> rating.mu >> rating.sigma
+                  && in.get() == ' ' && std::getline(in, rating.spec)) {
+            _index[rating.spec] = _ratings.size();
+            _ratings.push_back(rating);
+        }
+        if (!in.eof()) {
+            throw std::runtime_error("'" + path + "' ist keine Wertung");
+        }
+    }
+
+    /** Writes a snapshot, replacing the file only once it is written */
+    void save(const std::string &path) const {
+        std::string temporary = path + ".neu";
+        {
+            std::ofstream out(temporary.c_str(), std::ios::trunc);
+            out << std::setprecision(17);
+            for (size_t i = 0; i != _ratings.size(); ++i) {
+                out << _ratings[i].games << " " << _ratings[i].elo << " "
+                    << _ratings[i].mu << " " << _ratings[i].sigma << " "
+                    << _ratings[i].spec << "\n";
+            }
+            if (out.flush(), !out) {
+                throw std::runtime_error("Kann '" + temporary +
+                                         "' nicht schreiben");
+            }
+        }
+        if (::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Kann '" + path + "' nicht ersetzen: "
+                                     + strerror(errno));
+        }
+    }
+
+    /** Table of the programs, best conservative TrueSkill rating first */
+    void print(std::ostream &out) const {
+        std::vector<Rating> sorted(_ratings);
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Rating &l, const Rating &r) {
+                             return l.conservative() > r.conservative();
+                         });
+
+        out << "Wertung     Spiele     Elo      mu   sigma  Programm\n";
+        for (size_t i = 0; i != sorted.size(); ++i) {
+            out << std::setw(7) << i + 1
+                << std::setw(11) << sorted[i].games
+                << std::fixed << std::setprecision(0)
+                << std::setw(8) << sorted[i].elo
+                << std::setprecision(2)
+                << std::setw(8) << sorted[i].mu
+                << std::setw(8) << sorted[i].sigma
+                << "  " << sorted[i].spec << "\n";
+        }
+    }
+
+private:
+    Ratings(const Ratings &) = delete;
+    Ratings &operator=(const Ratings &) = delete;
+
+    /** Index of the rating of `spec`, which is added if it is new */
+    size_t _index_of(const char *spec, size_t length) {
+        std::string name(spec, std::min(length, size_t(GameRecord::SPEC_SIZE
+                                                       - 1)));
+        std::map<std::string, size_t>::iterator entry = _index.find(name);
+        if (entry == _index.end()) {
+            entry = _index.insert(std::make_pair(name, _ratings.size())).first;
+            _ratings.push_back(Rating(name));
+        }
+        return entry->second;
+    }
+
+    static double _pdf(double x) {
+        return std::exp(-0.5 * x * x) / std::sqrt(2 * M_PI);
+    }
+
+    static double _cdf(double x) { return 0.5 * std::erfc(-x / std::sqrt(2)); }
+
+    void _add(Rating &a, Rating &b, int result) {
+        if (&a == &b)
+            return;
+        ++a.games;
+        ++b.games;
+
+        double score = result == 1 ? 1 : result == 2 ? 0 : 0.5;
+        double expected = 1 / (1 + std::pow(10, (b.elo - a.elo) / 400));
+        a.elo += ELO_K * (score - expected);
+        b.elo -= ELO_K * (score - expected);
+
+        // TrueSkill: v and w correct the means and variances, from the
+        // winner's view unless it is a draw
+        Rating &winner = result == 2 ? b : a, &loser = result == 2 ? a : b;
+        double var_w = winner.sigma * winner.sigma + TAU * TAU;
+        double var_l = loser.sigma * loser.sigma + TAU * TAU;
+        double c = std::sqrt(2 * BETA * BETA + var_w + var_l);
+        double t = (winner.mu - loser.mu) / c, e = DRAW_MARGIN / c, v, w;
+        if (result == 1 || result == 2) {
+            double p = _cdf(t - e);
+            v = p > 1e-300 ? _pdf(t - e) / p : e - t;
+            w = v * (v + t - e);
+        } else {
+            double p = _cdf(e - t) - _cdf(-e - t);
+            if (p > 1e-300) {
+                v = (_pdf(-e - t) - _pdf(e - t)) / p;
+                w = v * v + ((e - t) * _pdf(e - t) + (e + t) * _pdf(-e - t)) / p;
+            } else {
+                v = t < 0 ? -t - e : e - t;     // as far off as it gets
+                w = 1;
+            }
+        }
+        winner.mu += var_w / c * v;
+        loser.mu -= var_l / c * v;
+        winner.sigma = std::sqrt(var_w * (1 - var_w / (c * c) * w));
+        loser.sigma = std::sqrt(var_l * (1 - var_l / (c * c) * w));
+    }
+
+    std::vector<Rating> _ratings;
+    std::map<std::string, size_t> _index;
+    std::mutex _mutex;
+};
+
+constexpr double Ratings::INITIAL_ELO, Ratings::ELO_K, Ratings::INITIAL_MU,
+                 Ratings::BETA, Ratings::TAU, Ratings::DRAW_MARGIN;
+
+/**
+ * Reads numbers and characters from a line like an istringstream in the "C"
+ * locale would: white space is skipped, numbers are decimal with an optional
+ * sign and must fit into an int.  Once something fails, the rest fails, too.
+ *
+ * The difference is that the end of the line counts as white space, so a
+ * line needs no trailing newline.
+ */
+class LineScanner
+{
+public:
+    LineScanner(const LineView &line)
+        : _pos(line.data), _end(line.data + line.size), _ok(true) { }
+
+    LineScanner &operator>>(int &value) {
+        _skip_space();
+        const char *start = _pos;
+        bool negative = _pos != _end && *_pos == '-';
+        if (_pos != _end && (*_pos == '-' || *_pos == '+'))
+            ++_pos;
+
+        const char *digits = _pos;
+        long long magnitude = 0;
+        for (; _pos != _end && *_pos >= '0' && *_pos <= '9'; ++_pos) {
+            // Saturate one past INT_MIN: larger numbers fail either way
+            magnitude = std::min(10 * magnitude + (*_pos - '0'),
+                                 -(long long)INT_MIN + 1);
+        }
+        if (_pos == digits
+                || magnitude > (negative ? -(long long)INT_MIN : INT_MAX)) {
+            _pos = start;
+            _ok = false;
+            return *this;
+        }
+        value = negative ? -magnitude : magnitude;
+        return *this;
+    }
+
+    LineScanner &operator>>(char &value) {
+        _skip_space();
+        if (_pos == _end) {
+            _ok = false;
+            return *this;
+        }
+        value = *_pos++;
+        return *this;
+    }
+
+    /** Whether everything was read, apart from trailing white space */
+    bool done() {
+        _skip_space();
+        return _ok && _pos == _end;
+    }
+
+private:
+    void _skip_space() {
+        if (!_ok)
+            return;
+        while (_pos != _end && (*_pos == ' ' || (*_pos >= '\t' && *_pos <= '\r')))
+            ++_pos;
+    }
+
+    const char *_pos, *_end;
+    bool _ok;
+};
+
+/** Range of valid coordinates for error messages, e.g. "0-9" */
+template <typename Rules>
+std::string field_range()
+{
+    return "0-" + std::to_string(std::max(int(Rules::rows), int(Rules::cols)) - 1);
+}
+
+/** Parses a line "zeile spalte richtung" and places the ship accordingly */
+template <typename Rules>
+void place_ship(BasicPlayer<Rules> &me, const LineView &line,
+                GameLog *log=nullptr)
+{
+    LineScanner scan(line);
+    int i = 0, j = 0;
+    char c = 0;
+    scan >> i >> j >> c;
+    if (!scan.done()) {
+        throw std::runtime_error(
+            "Ungueltige Eingabe - erwarte eine Zeile der Form:\n\n"
+            "   zeile spalte richtung\n\n"
+            "zeile, spalte kann eine Zahl von " + field_range<Rules>()
+            + " sein, Richtung muss\n"
+            "entweder U oder R sein");
+    }
+    if (c != 'R' && c != 'U') {
+        throw std::runtime_error(
+            "Ungueltige Richtung: muss entweder 'R' oder 'U' sein");
+    }
+    me.place(i, j, me.next_ship_size(), c == 'U');
+    if (log)
+        log->placement(me.which(), i, j, c == 'U');
+}
+
+/** Parses a line "zeile spalte" and fires at that field of `other` */
+template <typename Rules>
+ShotOutcome::Outcome fire_shot(BasicPlayer<Rules> &other, const LineView &line,
+                               int &i, int &j, GameLog *log=nullptr)
+{
+    LineScanner scan(line);
+    scan >> i >> j;
+    if (!scan.done()) {
+        throw std::runtime_error(
+            "Ungueltige Eingabe - erwarte eine Zeile der Form:\n\n"
+            "   zeile spalte\n\n"
+            "zeile, spalte kann eine Zahl von " + field_range<Rules>()
+            + " sein");
+    }
+    ShotOutcome::Outcome treffer = other.incoming(i, j);
+    if (log)
+        log->shot(other.which() == 'A' ? 'B' : 'A', i, j, treffer);
+    return treffer;
+}
+
+/** Tells the player who just fired the outcome of the shot */
+template <typename Rules>
+void send_outcome(BasicPlayer<Rules> &me, const BasicPlayer<Rules> &other,
+                  ShotOutcome::Outcome treffer)
+{
+    static const char outcomechar[] = {'F', 'T', 'V'};
+
+    if (!me.alive())
+        me.send('L');
+    else if (!other.alive())
+        me.send('W');
+    else
+        me.send(outcomechar[treffer]);
+}
+
+template <typename Rules>
+void place(BasicPlayer<Rules> &me, std::ostream &out, GameLog *log=nullptr)
+{
+    BasicPlayer<Rules> dummy(me.which() == 'A' ? 'B' : 'A');
+    bool am_human = !me.is_machine();
+    for (int ship=1; ship<=Rules::nships; ++ship) {
+        // Be nice to humans
+        if (am_human)
+            print_boards(out, me, dummy, false);
+
+        LineView line;
+        for (bool ok = false; !ok;) {
+            out << "Spieler " << me.which()
+                << " - Schiff #" << ship << " eingeben: ";
+            line = me.prompt();
+            if (line.empty())
+                continue;
+
+            try {
+                place_ship(me, line, log);
+                ok = true;
+                if (!am_human)
+                    out << "[Erfolgreich eigegeben, aber geheim]\n";
+            } catch(const std::runtime_error &e) {
+                if (am_human) {
+                    out << "Eingabefehler Spieler " << me.which() << ":\n"
+                        << e.what() << std::endl;
+                } else {
+                    if (out.rdbuf()) {
+                        out << "\nBisher gesetzt:\n";
+                        print_boards(out, me, dummy, false);
+                        out << "\nEingeben wurde:\n" << line;
+                    }
+                    throw;
+                }
+            }
+        }
+    }
+    if (am_human)
+        print_boards(out, me, dummy, false);
+}
+
+template <typename Rules>
+void shoot(BasicPlayer<Rules> &me, BasicPlayer<Rules> &other, std::ostream &out,
+           GameLog *log=nullptr)
+{
+    bool am_human = !me.is_machine();
+    static const std::string outcomestr[] =
+                        {" - daneben. ", " - TREFFER! ", " - VERSENKT!"};
+
+    // Be nice to humans
+    if (am_human)
+        print_boards(out, me, other, false);
+
+    LineView line;
+    ShotOutcome::Outcome treffer;
+    int i, j;
+    for (bool ok = false; !ok;) {
+        out << "Spieler " << me.which() << " - Zielfeld eingeben: ";
+        line = me.prompt();
+        if (line.empty())
+            continue;
+
+        try {
+            treffer = fire_shot(other, line, i, j, log);
+            ok = true;
+        } catch(const std::runtime_error &e) {
+            out << "Eingabefehler Spieler " << me.which() << ":\n"
+                << e.what() << std::endl;
+            if (!am_human) {
+                if (out.rdbuf()) {
+                    out << "\nJetziges Feld:\n";
+                    print_boards(out, me, other, true);
+                    out << "\nEingeben wurde:\n" << line;
+                }
+                throw;
+            }
+        }
     }
     if (!am_human) {
-        std::cerr << i << " " << j << outcomestr[treffer]
-                  << (other.is_machine() && me.which() == 'A' ? "  ---  " : "\n");
+        out << i << " " << j << outcomestr[treffer]
+            << (other.is_machine() && me.which() == 'A' ? "  ---  " : "\n");
+    }
+    send_outcome(me, other, treffer);
+}
+
+/**
+ * Plays a single game and returns the winner: 1 for A, 2 for B, 0 for a draw
+ * (these are also the exit codes of the program).
+ *
+ * If there is a `log`, the game and the response times of the players are
+ * recorded there.  The boards are only
+ * drawn if `out` goes anywhere, i.e., they are skipped in headless mode.
+ * Programs play against the `clock`, if it is enabled.
+ *
+ * Programs think while the referee waits for the other player, as they
+ * learn the outcome of their shot before it does.
+ */
+template <typename Rules>
+int play_game(BasicPlayer<Rules> &player_a, BasicPlayer<Rules> &player_b,
+              std::ostream &out, GameLog *log=nullptr,
+              const TimeControl &clock=TimeControl())
+{
+    if (log) {
+        log->variant<Rules>();
+        player_a.time_responses(&log->latencies(0));
+        player_b.time_responses(&log->latencies(1));
+    }
+    player_a.start_clock(clock);
+    player_b.start_clock(clock);
+
+    // placement phase
+    out << "\nSpieler A setzt Schiffe:\n";
+    try {
+        place(player_a, out, log);
+    } catch(const std::runtime_error &e) {
+        player_a.fail();
+        if (log)
+            log->failure('A', e);
+        out << "\n\n" << e.what()
+            << "\nSpieler B hat gewonnen! (Illegale Platzierung von A)\n";
+        return 2;
+    }
+    out << "\nSpieler B setzt Schiffe:\n";
+    try {
+        place(player_b, out, log);
+    } catch(const std::runtime_error &e) {
+        player_b.fail();
+        if (log)
+            log->failure('B', e);
+        out << "\n\n" << e.what()
+            << "\nSpieler A hat gewonnen! (Illegale Platzierung von B)\n";
+        return 1;
+    }
+
+    out << "\nLos gehts!\n";
+    // shootout phase
+    for (int move = 1; player_a.alive() && player_b.alive(); ++move) {
+        if (move == Rules::max_moves + 1) {
+            out << Rules::max_moves << " Züge gespielt - das ist genug.\n";
+            player_a.die();
+            player_b.die();
+            if (log)
+                log->move_limit();
+            break;
+        }
+        out << "Zug " << std::setw(3) << move << ": ";
+        try {
+            shoot(player_a, player_b, out, log);
+        } catch(const std::runtime_error &e) {
+            out << "\n\n" << e.what() << "\nIllegale Aktion von A\n";
+            player_a.fail();
+            if (log)
+                log->failure('A', e);
+            break;
+        }
+        try {
+            shoot(player_b, player_a, out, log);
+        } catch(const std::runtime_error &e) {
+            out << "\n\n" << e.what() << "\nIllegaler Aktion von B\n";
+            player_b.fail();
+            if (log)
+                log->failure('B', e);
+            break;
+        }
+    }
+
+    // scoring
+    if (out.rdbuf())
+        print_boards(out, player_a, player_b, true);
+    if (player_a.alive()) {
+        out << "Spieler A hat gewonnen!\n";
+        return 1;
+    } else if (player_b.alive()) {
+        out << "Spieler B hat gewonnen!\n";
+        return 2;
+    } else {
+        out << "Unentschieden ...\n";
+        return 0;
+    }
+}
+
+/**
+ * Idle processes of programs that can play several games in a row.
+ *
+ * Instead of killing such a program after a game, it is parked here and the
+ * next game of the same program gets it back, announced to the program by
+ * the line "N".  Programs speaking the plain protocol are started anew for
+ * every game.
+ *
+ * With prestart(), a background thread keeps a few processes of every such
+ * program started ahead of time, so a game does not wait for process
+ * creation while other games are still running.
+ */
+class SessionPool
+{
+public:
+    SessionPool() : _depth(0), _stopping(false), _spawns(0), _spawn_ns(0) { }
+
+    ~SessionPool() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wanted.notify_all();
+        if (_starter.joinable())
+            _starter.join();
+    }
+
+    /** Keeps `depth` processes of every program started in advance */
+    void prestart(size_t depth) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _depth = depth;
+        if (_depth != 0 && !_starter.joinable())
+            _starter = std::thread(&SessionPool::_start_ahead, this);
+    }
+
+    ChildProcess acquire(const std::string &spec) {
+        for (;;) {
+            ChildProcess child;
+            {
+                std::lock_guard<std::mutex> lock(_mutex);
+                std::vector<ChildProcess> &idle = _idle[spec];
+                if (idle.empty())
+                    break;
+                child = std::move(idle.back());
+                idle.pop_back();
+            }
+            try {
+                if (!child.renew_cpu_limit())
+                    continue;               // to be replaced, see there
+                child.send("N\n");
+                return child;
+            } catch(const std::runtime_error &e) {
+                // program has gone away in the meantime: try the next one
+            }
+        }
+        ChildProcess child;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (_depth != 0) {
+                // this entry also tells the background thread about `spec`
+                std::deque<ChildProcess> &fresh = _fresh[spec];
+                if (!fresh.empty()) {
+                    // oldest first: it has had the most time to get ready
+                    child = std::move(fresh.front());
+                    fresh.pop_front();
+                }
+            }
+        }
+        _wanted.notify_one();
+        if (child.started() && child.renew_cpu_limit())
+            return child;
+        return _spawn(spec);
+    }
+
+    /** Starts a player for `spec`: a plugin, or a program from the pool */
+    template <typename Rules = Standard>
+    BasicPlayer<Rules> start(char which, const std::string &spec) {
+        if (PluginBot::is_spec(spec)) {
+            return BasicPlayer<Rules>(which,
+                                      PluginBot(spec, GameVariant::of<Rules>()));
+        }
+        if (SocketBot::is_spec(spec)) {
+            return BasicPlayer<Rules>(which,
+                                      SocketBot(spec, GameVariant::of<Rules>()));
+        }
+        return BasicPlayer<Rules>(which, acquire(spec));
+    }
+
+    void release(const std::string &spec, ChildProcess &&child) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _idle[spec].push_back(std::move(child));
+        _multi.insert(spec);
+    }
+
+    /** Processes started so far, also those started in advance */
+    uint64_t spawns() const { return _spawns; }
+
+    /** Time it took to start them, in total */
+    uint64_t spawn_ns() const { return _spawn_ns; }
+
+    /**
+     * Plays a game nobody watches between `spec_a` and `spec_b`, recording it
+     * in `log`, and parks the programs again afterwards.  Returns the result
+     * as play_game() does.
+     */
+    template <typename Rules = Standard>
+    int play(const std::string &spec_a, const std::string &spec_b,
+             GameLog &log, const TimeControl &clock=TimeControl()) {
+        static const char result_a[] = {'U', 'W', 'L'};
+        static const char result_b[] = {'U', 'L', 'W'};
+
+        std::ostream quiet(nullptr);
+        BasicPlayer<Rules> player_a = start<Rules>('A', spec_a);
+        BasicPlayer<Rules> player_b = start<Rules>('B', spec_b);
+        log.clear();
+        int result = play_game(player_a, player_b, quiet, &log, clock);
+        bool reuse_a = player_a.conclude(result_a[result]);
+        bool reuse_b = player_b.conclude(result_b[result]);
+        log.usage(0) = player_a.take_usage(reuse_a);
+        log.usage(1) = player_b.take_usage(reuse_b);
+        if (reuse_a)
+            release(spec_a, player_a.release_child());
+        if (reuse_b)
+            release(spec_b, player_b.release_child());
+        return result;
+    }
+
+private:
+    SessionPool(const SessionPool &) = delete;
+    SessionPool &operator=(const SessionPool &) = delete;
+
+    ChildProcess _spawn(const std::string &spec) {
+        uint64_t start = monotonic_ns();
+        ChildProcess child(spec);
+        _spawn_ns += monotonic_ns() - start;
+        ++_spawns;
+        return child;
+    }
+
+    /** Returns a program with fewer than _depth fresh processes, or "" */
+    std::string _next_short() {
+        std::map<std::string, std::deque<ChildProcess> >::iterator it;
+        for (it = _fresh.begin(); it != _fresh.end(); ++it) {
+            // programs that are parked after a game need no fresh processes
+            if (it->second.size() < _depth && !_multi.count(it->first))
+                return it->first;
+        }
+        return std::string();
+    }
+
+    /** Body of the background thread of prestart() */
+    void _start_ahead() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        for (;;) {
+            std::string spec;
+            _wanted.wait(lock, [&] {
+                return _stopping || !(spec = _next_short()).empty();
+            });
+            if (_stopping)
+                return;
+
+            lock.unlock();
+            ChildProcess child = _spawn(spec);
+            lock.lock();
+            _fresh[spec].push_back(std::move(child));
+        }
+    }
+
+    std::mutex _mutex;
+    std::map<std::string, std::vector<ChildProcess> > _idle;
+    std::map<std::string, std::deque<ChildProcess> > _fresh;
+    std::set<std::string> _multi;
+    size_t _depth;
+    bool _stopping;
+    std::condition_variable _wanted;
+    std::thread _starter;
+    std::atomic<uint64_t> _spawns, _spawn_ns;
+};
+
+/**
+ * Counters and gauges of a running tournament, to watch long runs.  Every
+ * worker thread counts into cache lines of its own with relaxed atomic
+ * adds, so counting takes no lock and workers share no cache lines; the
+ * sums over the workers are only formed when the metrics are written.
+ *
+ * export_to() writes them every few seconds to a file in the text format of
+ * Prometheus, e.g., for the textfile collector of its node exporter.
+ */
+class Metrics
+{
+public:
+    Metrics(const std::vector<std::string> &specs, unsigned nworkers,
+            const SessionPool &sessions)
+        : _specs(specs)
+        , _nworkers(std::max(nworkers, 1u))
+        , _stride((ERRORS + specs.size() * NERRORS + 7) / 8 * 8)
+        , _storage(new std::atomic<uint64_t>[_nworkers * _stride + 8])
+        , _sessions(sessions)
+        , _scheduled(0)
+        , _start_ns(monotonic_ns())
+        , _last_ns(_start_ns)
+        , _last_games(0)
+        , _last_moves(0)
+        , _stopping(false)
+        , _failed(false)
+    {
+        for (size_t i = 0; i != specs.size(); ++i)
+            _index[specs[i]] = i;
+
+        // Start the counters of the first worker at a cache line
+        size_t misalignment = reinterpret_cast<uintptr_t>(&_storage[0]) % 64;
+        _counters = &_storage[misalignment ? (64 - misalignment) / 8 : 0];
+        for (size_t i = 0; i != _nworkers * _stride; ++i)
+            _counters[i].store(0, std::memory_order_relaxed);
+    }
+
+    ~Metrics() { stop(); }
+
+    /** `games` more games are waiting to be played */
+    void schedule(size_t games) { _scheduled += games; }
+
+    /** Worker `worker` begins a game */
+    void started(unsigned worker) { _add(worker, STARTED, 1); }
+
+    /** Worker `worker` has finished a game, as recorded in `log` */
+    void finished(unsigned worker, const std::string &spec_a,
+                  const std::string &spec_b, const GameLog &log) {
+        _add(worker, GAMES, 1);
+        _add(worker, MOVES, log.shots());
+        if (!log.failed())
+            return;
+        std::map<std::string, size_t>::const_iterator program =
+                    _index.find(log.failed() == 'A' ? spec_a : spec_b);
+        int error = log.reason() - GameLog::ILLEGAL_PLACEMENT;
+        if (program != _index.end() && error >= 0 && error < NERRORS)
+            _add(worker, ERRORS + program->second * NERRORS + error, 1);
+    }
+
+    /** Writes the metrics to `path` every `interval_ms` from now on */
+    void export_to(const std::string &path, int interval_ms=5000) {
+        _path = path;
+        _interval_ms = interval_ms;
+        _exporter = std::thread(&Metrics::_export, this);
+    }
+
+    /** Stops exporting, writing the metrics one last time */
+    void stop() {
+        if (!_exporter.joinable())
+            return;
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _wakeup.notify_all();
+        _exporter.join();
+        save();
+    }
+
+    /** Replaces the file given to export_to() by the current metrics */
+    void save() {
+        std::string temporary = _path + ".neu";
+        {
+            std::ofstream out(temporary.c_str(), std::ios::trunc);
+            write(out);
+            if (out.flush(), !out) {
+                _report("Kann '" + temporary + "' nicht schreiben");
+                return;
+            }
+        }
+        if (::rename(temporary.c_str(), _path.c_str()) != 0) {
+            _report("Kann '" + _path + "' nicht ersetzen: "
+                    + strerror(errno));
+        }
+    }
+
+    /** Writes the metrics in the text format of Prometheus */
+    void write(std::ostream &out) {
+        uint64_t now = monotonic_ns();
+        uint64_t games = _sum(GAMES), moves = _sum(MOVES);
+        uint64_t started = _sum(STARTED);
+        double seconds = std::max(now - _last_ns, uint64_t(1)) * 1e-9;
+
+        _metric(out, "spiele_total", "counter", "Gespielte Spiele", games);
+        _metric(out, "zuege_total", "counter", "Schuesse aller Spieler", moves);
+        _metric(out, "spiele_pro_sekunde", "gauge",
+                "Spiele pro Sekunde seit dem letzten Schreiben",
+                (games - _last_games) / seconds);
+        _metric(out, "zuege_pro_sekunde", "gauge",
+                "Schuesse pro Sekunde seit dem letzten Schreiben",
+                (moves - _last_moves) / seconds);
+        _metric(out, "warteschlange", "gauge", "Spiele, die noch warten",
+                _scheduled - std::min<uint64_t>(started, _scheduled));
+        _metric(out, "laufende_spiele", "gauge", "Spiele, die gerade laufen",
+                started - std::min(games, started));
+        _metric(out, "laufzeit_sekunden", "gauge", "Zeit seit dem Start",
+                (now - _start_ns) * 1e-9);
+        _metric(out, "programmstart_sekunden_sum", "counter",
+                "Zeit, die das Starten von Programmen dauerte",
+                _sessions.spawn_ns() * 1e-9);
+        _metric(out, "programmstart_sekunden_count", "counter",
+                "Gestartete Programme", _sessions.spawns());
+
+        _header(out, "worker_spiele_total", "counter",
+                "Gespielte Spiele je Worker-Thread");
+        for (unsigned worker = 0; worker != _nworkers; ++worker) {
+            out << PREFIX << "worker_spiele_total{worker=\"" << worker
+                << "\"} " << _counter(worker, GAMES).load(
+                                                std::memory_order_relaxed)
+                << "\n";
+        }
+
+        _header(out, "fehler_total", "counter",
+                "Spiele, die ein Programm durch einen Fehler verlor");
+        for (size_t program = 0; program != _specs.size(); ++program) {
+            for (int error = 0; error != NERRORS; ++error) {
+                out << PREFIX << "fehler_total{programm=\""
+                    << _escaped(_specs[program]) << "\",grund=\""
+                    << GameLog::reason_name(GameLog::ILLEGAL_PLACEMENT + error)
+                    << "\"} " << _sum(ERRORS + program * NERRORS + error)
+                    << "\n";
+            }
+        }
+
+        _last_ns = now;
+        _last_games = games;
+        _last_moves = moves;
+    }
+
+private:
+    Metrics(const Metrics &) = delete;
+    Metrics &operator=(const Metrics &) = delete;
+
+    /** Counters of a worker; then NERRORS error counters per program */
+    enum { STARTED, GAMES, MOVES, ERRORS };
+
+    /** Illegal placement, illegal action, out of time */
+    enum { NERRORS = GameLog::NREASONS - GameLog::ILLEGAL_PLACEMENT };
+
+    static constexpr const char *PREFIX = "schiffe_versenken_";
+
+    std::atomic<uint64_t> &_counter(unsigned worker, size_t which) {
+        return _counters[worker * _stride + which];
+    }
+
+    void _add(unsigned worker, size_t which, uint64_t value) {
+        _counter(worker, which).fetch_add(value, std::memory_order_relaxed);
+    }
+
+    uint64_t _sum(size_t which) {
+        uint64_t sum = 0;
+        for (unsigned worker = 0; worker != _nworkers; ++worker)
+            sum += _counter(worker, which).load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    static void _header(std::ostream &out, const char *name, const char *type,
+                        const char *help) {
+        out << "# HELP " << PREFIX << name << " " << help << "\n"
+            << "# TYPE " << PREFIX << name << " " << type << "\n";
+    }
+
+    template <typename T>
+    static void _metric(std::ostream &out, const char *name, const char *type,
+                        const char *help, T value) {
+        _header(out, name, type, help);
+        out << PREFIX << name << " " << value << "\n";
+    }
+
+    /** `text` as a label value, with backslashes, quotes and newlines escaped */
+    static std::string _escaped(const std::string &text) {
+        std::string escaped;
+        for (size_t i = 0; i != text.size(); ++i) {
+            if (text[i] == '\\' || text[i] == '"')
+                escaped += '\\';
+            escaped += text[i] == '\n' ? std::string("\\n")
+                                       : std::string(1, text[i]);
+        }
+        return escaped;
+    }
+
+    void _report(const std::string &error) {
+        // once is enough; the tournament goes on anyway
+        if (!_failed)
+            std::cerr << "Fehler: " << error << std::endl;
+        _failed = true;
+    }
+
+    /** Body of the thread of export_to() */
+    void _export() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (!_wakeup.wait_for(lock, std::chrono::milliseconds(_interval_ms),
+                                 [this] { return _stopping; })) {
+            lock.unlock();
+            save();
+            lock.lock();
+        }
+    }
+
+    std::vector<std::string> _specs;
+    std::map<std::string, size_t> _index;
+    unsigned _nworkers;
+    size_t _stride;                 // counters per worker, whole cache lines
+    std::unique_ptr<std::atomic<uint64_t>[]> _storage;
+    std::atomic<uint64_t> *_counters;
+    const SessionPool &_sessions;
+    std::atomic<uint64_t> _scheduled;
+    uint64_t _start_ns, _last_ns, _last_games, _last_moves;
+    std::string _path;
+    int _interval_ms;
+    std::thread _exporter;
+    std::mutex _mutex;
+    std::condition_variable _wakeup;
+    bool _stopping, _failed;
+};
+
+constexpr const char *Metrics::PREFIX;
+
+/**
+ * Hashed timer wheel: a timer is put into the slot of the tick it expires
+ * at, so adding timers and advancing time does not depend on how many
+ * timers there are.  Timers cannot be cancelled; instead, their owners
+ * recognize and ignore stale timers by the key.
+ */
+class TimerWheel
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    TimerWheel(int tick_ms=10, size_t nslots=512)
+        : _tick_ms(tick_ms)
+        , _slots(nslots)
+        , _start(Clock::now())
+        , _current(0)
+        , _size(0)
+    { }
+
+    void add(int timeout_ms, uint64_t key) {
+        uint64_t expiry = _now() + (timeout_ms + _tick_ms - 1) / _tick_ms;
+        _slots[expiry % _slots.size()].push_back(Timer(expiry, key));
+        ++_size;
+    }
+
+    /** Milliseconds until the next tick is due, or -1 if there is no timer */
+    int wait_ms() const {
+        if (_size == 0)
+            return -1;
+        long elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                        Clock::now() - _start).count();
+        return std::max(0L, long(_current * _tick_ms) - elapsed);
+    }
+
+    /** Removes all timers that are due and calls expire(key) for them */
+    template <typename Callback>
+    void advance(Callback expire) {
+        uint64_t now = _now();
+        uint64_t last = std::min(now, _current + _slots.size() - 1);
+        for (uint64_t tick = _current; tick <= last; ++tick) {
+            std::vector<Timer> &slot = _slots[tick % _slots.size()];
+            for (size_t i = 0; i != slot.size(); ) {
+                if (slot[i].expiry <= now) {
+                    _expired.push_back(slot[i].key);
+                    slot[i] = slot.back();
+                    slot.pop_back();
+                    --_size;
+                } else {
+                    ++i;
+                }
+            }
+        }
+        _current = now + 1;
+
+        // expire() may add new timers, so only call it after the scan
+        for (size_t i = 0; i != _expired.size(); ++i)
+            expire(_expired[i]);
+        _expired.clear();
+    }
+
+private:
+    struct Timer {
+        Timer(uint64_t expiry, uint64_t key) : expiry(expiry), key(key) { }
+
+        uint64_t expiry, key;
+    };
+
+    uint64_t _now() const {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                                Clock::now() - _start).count() / _tick_ms;
+    }
+
+    int _tick_ms;
+    std::vector<std::vector<Timer> > _slots;
+    std::vector<uint64_t> _expired;
+    Clock::time_point _start;
+    uint64_t _current;
+    size_t _size;
+};
+
+/**
+ * Plays many games between programs from a single thread.
+ *
+ * Every game is a state machine (placement, shooting, and finally waiting
+ * for the lines multi-game programs still owe), which is advanced whenever
+ * one of its programs has written something, as reported by epoll.  How
+ * long a program may take for a line is watched by a TimerWheel.  The
+ * rules are the same as in play_game(), but nothing is printed.
+ */
+class EventEngine
+{
+public:
+    /**
+     * If `games_out` is given, every game is written there as a JSON line;
+     * if `records` is given, every game is appended to that record file, and
+     * if `ratings` are given, they are updated after every game, and so are
+     * the `metrics`, as those of worker 0.  Programs play against `clock`, if
+     * it is enabled.
+     */
+    EventEngine(SessionPool &sessions, size_t max_games,
+                std::ostream *games_out=nullptr, RecordWriter *records=nullptr,
+                const TimeControl &clock=TimeControl(),
+                Ratings *ratings=nullptr, Metrics *metrics=nullptr)
+        : _sessions(sessions)
+        , _epoll(checked(epoll_create1(EPOLL_CLOEXEC)))
+        , _matches(std::max(max_games, size_t(1)))
+        , _games_out(games_out)
+        , _records(records)
+        , _ratings(ratings)
+        , _metrics(metrics)
+        , _clock(clock)
+        , _generation(0)
+    {
+        for (size_t slot = _matches.size(); slot-- != 0; )
+            _free.push_back(slot);
+        _logs.resize(_matches.size());
+    }
+
+    ~EventEngine() { ::close(_epoll); }
+
+    /**
+     * Schedules a game, whose winner is stored in `*result` when it is over.
+     * The response times of the players are added to `latencies`, and the
+     * resources their programs used to `usage`, if given.
+     */
+    void add(const std::string &spec_a, const std::string &spec_b, int *result,
+             Latencies *latencies_a=nullptr, Latencies *latencies_b=nullptr,
+             ResourceUsage *usage_a=nullptr, ResourceUsage *usage_b=nullptr) {
+        _queue.push_back(Request(spec_a, spec_b, result));
+        _queue.back().latencies[0] = latencies_a;
+        _queue.back().latencies[1] = latencies_b;
+        _queue.back().usage[0] = usage_a;
+        _queue.back().usage[1] = usage_b;
+    }
+
+    void run() {
+        std::vector<epoll_event> events(128);
+        size_t next = 0;
+        while (next != _queue.size() || _free.size() != _matches.size()) {
+            while (next != _queue.size() && !_free.empty())
+                _start(_queue[next++]);
+
+            int nevents = epoll_wait(_epoll, events.data(), events.size(),
+                                     _timers.wait_ms());
+            if (nevents < 0 && errno == EINTR)
+                continue;
+            checked(nevents);
+
+            for (int i = 0; i != nevents; ++i) {
+                size_t slot = events[i].data.u64 / 2;
+                int which = events[i].data.u64 % 2;
+                if (!_matches[slot])
+                    continue;       // game was finished by an earlier event
+
+                Match &match = *_matches[slot];
+                ChildProcess &child = match.player[which].child();
+                try {
+                    child.fill();
+                    if (child.eof())
+                        _unwatch(match, which);
+                } catch(const std::runtime_error &e) {
+                    // will time out when it is the player's turn
+                    _unwatch(match, which);
+                }
+                _advance(slot);
+            }
+
+            _timers.advance([&](uint64_t key) {
+                size_t slot = key >> 32;
+                unsigned generation = key & 0xFFFFFFFFu;
+                if (_matches[slot] && _matches[slot]->generation == generation)
+                    _timeout(slot);
+            });
+        }
+        _queue.clear();
+    }
+
+private:
+    enum { LINE_TIMEOUT_MS = 2000 };
+
+    struct Request {
+        Request(const std::string &spec_a, const std::string &spec_b,
+                int *result)
+            : spec_a(spec_a), spec_b(spec_b), result(result) { }
+
+        std::string spec_a, spec_b;
+        int *result;
+        Latencies *latencies[2];
+        ResourceUsage *usage[2];
+    };
+
+    struct Match {
+        enum State { PLACING, SHOOTING, DRAINING };
+
+        Match(const Request &request, SessionPool &sessions)
+            : request(request)
+            , state(PLACING)
+            , turn(0)
+            , ships(0)
+            , move(1)
+            , result(0)
+            , generation(0)
+            , armed(false)
+            , log(nullptr)
+        {
+            player[0] = sessions.start('A', request.spec_a);
+            player[1] = sessions.start('B', request.spec_b);
+            watched[0] = watched[1] = false;
+        }
+
+        Request request;
+        Player player[2];
+        bool watched[2];
+        State state;
+        int turn, ships, move, result;
+        unsigned generation;        // of the timer currently running
+        bool armed;                 // for the line awaited now, see _arm()
+        GameLog *log;
+    };
+
+    void _start(const Request &request) {
+        size_t slot = _free.back();
+        _free.pop_back();
+        if (_metrics)
+            _metrics->started(0);
+        _matches[slot].reset(new Match(request, _sessions));
+
+        Match &match = *_matches[slot];
+        match.log = &_logs[slot];
+        match.log->clear();
+        match.player[0].time_responses(&match.log->latencies(0));
+        match.player[1].time_responses(&match.log->latencies(1));
+        match.player[0].start_clock(_clock);
+        match.player[1].start_clock(_clock);
+        for (int which = 0; which != 2; ++which) {
+            // Plugins move right away when asked: nothing to wait for
+            if (match.player[which].is_plugin())
+                continue;
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.u64 = 2 * slot + which;
+            checked(epoll_ctl(_epoll, EPOLL_CTL_ADD,
+                    match.player[which].child().from_child().fd_read(), &event));
+            match.watched[which] = true;
+        }
+        _advance(slot);
+    }
+
+    void _unwatch(Match &match, int which) {
+        if (match.watched[which]) {
+            epoll_ctl(_epoll, EPOLL_CTL_DEL,
+                      match.player[which].child().from_child().fd_read(), NULL);
+            match.watched[which] = false;
+        }
+    }
+
+    /** Processes all lines of a game that have arrived so far */
+    void _advance(size_t slot) {
+        Match &match = *_matches[slot];
+        try {
+            LineView line;
+            while (match.state != Match::DRAINING) {
+                if (!match.player[match.turn].try_prompt(line)) {
+                    if (!match.armed)
+                        _arm(slot);
+                    return;
+                }
+                match.armed = false;
+                _play(match, line);
+            }
+        } catch(const std::runtime_error &e) {
+            _forfeit(match, e);
+        }
+        _drain(slot);
+    }
+
+    void _play(Match &match, const LineView &line) {
+        Player &me = match.player[match.turn];
+        Player &other = match.player[1 - match.turn];
+        if (match.state == Match::PLACING) {
+            place_ship(me, line, match.log);
+            if (++match.ships == Standard::nships) {
+                match.ships = 0;
+                if (match.turn == 0)
+                    match.turn = 1;
+                else
+                    match.state = Match::SHOOTING, match.turn = 0;
+            }
+        } else {
+            int i, j;
+            Player::Outcome treffer = fire_shot(other, line, i, j, match.log);
+            send_outcome(me, other, treffer);
+            if (match.turn == 0) {
+                match.turn = 1;
+                return;
+            }
+            match.turn = 0;
+            if (me.alive() && other.alive()
+                    && ++match.move == Standard::max_moves + 1) {
+                me.die();
+                other.die();
+                if (match.log)
+                    match.log->move_limit();
+            }
+            if (!me.alive() || !other.alive())
+                _score(match);
+        }
+    }
+
+    /** The player on turn made an illegal action or took too long */
+    void _forfeit(Match &match, const std::runtime_error &error) {
+        match.player[match.turn].fail();
+        match.armed = false;
+        if (match.log)
+            match.log->failure(match.player[match.turn].which(), error);
+        if (match.state == Match::PLACING)
+            match.result = match.turn == 0 ? 2 : 1;
+        else
+            _score(match);
+        match.state = Match::DRAINING;
+    }
+
+    void _score(Match &match) {
+        if (match.player[0].alive())
+            match.result = 1;
+        else if (match.player[1].alive())
+            match.result = 2;
+        else
+            match.result = 0;
+        match.state = Match::DRAINING;
+    }
+
+    /** Waits for lines which multi-game programs still owe, then finishes */
+    void _drain(size_t slot) {
+        Match &match = *_matches[slot];
+        LineView line;
+        for (int which = 0; which != 2; ++which) {
+            Player &player = match.player[which];
+            player.time_responses(nullptr);     // the game is over
+            player.stop_clock();
+            if (player.failed()
+                    || player.child().protocol() != ChildProcess::MULTI_GAME)
+                continue;
+            try {
+                while (player.pending() > 0) {
+                    if (!player.try_prompt(line)) {
+                        if (!match.armed)
+                            _arm(slot);
+                        return;
+                    }
+                    match.armed = false;
+                }
+            } catch(const std::runtime_error &e) {
+                player.fail();
+                match.armed = false;
+            }
+        }
+        _finish(slot);
+    }
+
+    void _timeout(size_t slot) {
+        Match &match = *_matches[slot];
+        if (match.state == Match::DRAINING) {
+            for (int which = 0; which != 2; ++which) {
+                if (match.player[which].pending() > 0)
+                    match.player[which].fail();
+            }
+            _finish(slot);
+        } else {
+            Player &player = match.player[match.turn];
+            if (player.clock_ms() > 0) {
+                // the wheel may fire a tick early: the clock is still running
+                _arm(slot);
+                return;
+            }
+            bool clocked = player.clock_ms() == 0;
+            player.give_up();
+            if (clocked) {
+                _forfeit(match, Timeout());
+            } else {
+                _forfeit(match, std::runtime_error(
+                                "Timeout: das Spieler-Programm hat innerhalb "
+                                "einiger Zeit keine Zeile geschrieben"));
+            }
+            _drain(slot);
+        }
+    }
+
+    /**
+     * Waits for the player on turn until the line or its clock is due.  Each
+     * awaited line gets one deadline: lines of the other player must not
+     * extend it, so callers arm only after a line was consumed.
+     */
+    void _arm(size_t slot) {
+        Match &match = *_matches[slot];
+        int timeout_ms = LINE_TIMEOUT_MS;
+        if (match.state != Match::DRAINING
+                && match.player[match.turn].clock_ms() >= 0)
+            timeout_ms = match.player[match.turn].clock_ms() + 1;
+        match.generation = ++_generation;
+        match.armed = true;
+        _timers.add(timeout_ms, (uint64_t(slot) << 32) | match.generation);
+    }
+
+    void _finish(size_t slot) {
+        static const char result_char[2][3] = {{'U', 'W', 'L'}, {'U', 'L', 'W'}};
+
+        Match &match = *_matches[slot];
+        const std::string *spec[2] = {&match.request.spec_a,
+                                      &match.request.spec_b};
+        for (int which = 0; which != 2; ++which) {
+            _unwatch(match, which);
+            Player &player = match.player[which];
+            bool reused = player.conclude(result_char[which][match.result]);
+            match.log->usage(which) = player.take_usage(reused);
+            if (reused)
+                _sessions.release(*spec[which], player.release_child());
+        }
+        *match.request.result = match.result;
+        for (int which = 0; which != 2; ++which) {
+            if (match.request.latencies[which])
+                match.request.latencies[which]->merge(match.log->latencies(which));
+            if (match.request.usage[which])
+                match.request.usage[which]->merge(match.log->usage(which));
+        }
+        if (_games_out)
+            match.log->write(*_games_out, *spec[0], *spec[1], match.result);
+        if (_records) {
+            GameRecord record;
+            match.log->fill(record, *spec[0], *spec[1], match.result);
+            _records->append(record);
+        }
+        if (_ratings)
+            _ratings->add(*spec[0], *spec[1], match.result);
+        if (_metrics)
+            _metrics->finished(0, *spec[0], *spec[1], *match.log);
+        _matches[slot].reset();
+        _free.push_back(slot);
+    }
+
+    SessionPool &_sessions;
+    int _epoll;
+    std::vector<std::unique_ptr<Match> > _matches;
+    std::vector<GameLog> _logs;
+    std::ostream *_games_out;
+    RecordWriter *_records;
+    Ratings *_ratings;
+    Metrics *_metrics;
+    TimeControl _clock;
+    std::vector<size_t> _free;
+    std::vector<Request> _queue;
+    TimerWheel _timers;
+    unsigned _generation;
+};
+
+/**
+ * Results of earlier tournaments, so that pairings of programs that did not
+ * change need not be played again.  A pairing is keyed by the contents of
+ * both programs and by everything else that decides its games: the version
+ * of the referee, the variant, the clock and the resource limits.
+ *
+ * The file has a line "HASH_A HASH_B CONFIG RESULTS" per pairing, where
+ * RESULTS has one digit per game as returned by play_game().
+ */
+class ResultCache
+{
+public:
+    /** Loads the results in `path`; if there is no such file, none */
+    explicit ResultCache(const std::string &path) : _path(path) {
+        std::ifstream in(path.c_str());
+        std::string hash_a, hash_b, config, results;
+        while (in >> hash_a >> hash_b >> config >> results)
+            _entries[hash_a + " " + hash_b + " " + config] = results;
+    }
+
+    /**
+     * Hash of the file of program `spec`, or of its library for plugins.
+     * Bot servers have none, as there is no telling what they run.
+     */
+    static std::string program_hash(const std::string &spec) {
+        if (SocketBot::is_spec(spec))
+            return std::string();
+        std::string path = PluginBot::is_spec(spec) ? spec.substr(4) : spec;
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            throw std::runtime_error("Kann Programm '" + path +
+                                     "' nicht lesen: " + strerror(errno));
+        }
+
+        // 64-bit FNV-1a: tells versions of a program apart, nothing more
+        uint64_t hash = 14695981039346656037ull;
+        char buffer[1 << 16];
+        ssize_t n;
+        while ((n = ::read(fd, buffer, sizeof(buffer))) != 0) {
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n < 0) {
+                std::string error = strerror(errno);
+                ::close(fd);
+                throw std::runtime_error("Kann Programm '" + path +
+                                         "' nicht lesen: " + error);
+            }
+            for (ssize_t i = 0; i != n; ++i)
+                hash = (hash ^ uint8_t(buffer[i])) * 1099511628211ull;
+        }
+        ::close(fd);
+
+        char text[17];
+        snprintf(text, sizeof(text), "%016llx", (unsigned long long)hash);
+        return text;
+    }
+
+    /** What besides the programs decides games of variant `Rules` */
+    template <typename Rules>
+    static std::string config(const TimeControl &clock) {
+        std::string text = "v" + VERSION + "," + Rules::describe();
+        std::replace(text.begin(), text.end(), ' ', ':');
+        const ResourceLimits &limits = ChildProcess::limits();
+        return text + ",zeit=" + std::to_string(clock.budget_ms) + "+"
+               + std::to_string(clock.increment_ms)
+               + (clock.announce ? "z" : "")
+               + ",cpu=" + std::to_string(limits.cpu_s)
+               + ",mb=" + std::to_string(limits.memory_mb);
+    }
+
+    /** Results of the pairing, or an empty string if it was not played */
+    std::string find(const std::string &hash_a, const std::string &hash_b,
+                     const std::string &config) const {
+        std::map<std::string, std::string>::const_iterator entry =
+                    _entries.find(hash_a + " " + hash_b + " " + config);
+        return entry != _entries.end() ? entry->second : std::string();
+    }
+
+    void store(const std::string &hash_a, const std::string &hash_b,
+               const std::string &config, const std::string &results) {
+        _entries[hash_a + " " + hash_b + " " + config] = results;
+    }
+
+    /** Writes all results, replacing the file only once they are written */
+    void save() const {
+        std::string temporary = _path + ".neu";
+        {
+            std::ofstream out(temporary.c_str(), std::ios::trunc);
+            std::map<std::string, std::string>::const_iterator entry;
+            for (entry = _entries.begin(); entry != _entries.end(); ++entry)
+                out << entry->first << " " << entry->second << "\n";
+            if (out.flush(), !out) {
+                throw std::runtime_error("Kann '" + temporary +
+                                         "' nicht schreiben");
+            }
+        }
+        if (::rename(temporary.c_str(), _path.c_str()) != 0) {
+            throw std::runtime_error("Kann '" + _path + "' nicht ersetzen: "
+                                     + strerror(errno));
+        }
+    }
+
+private:
+    std::string _path;
+    std::map<std::string, std::string> _entries;
+};
+
+/**
+ * Round-robin or gauntlet tournament between programs.
+ *
+ * Every game is an independent job; a pool of worker threads takes jobs off
+ * a shared counter, so games of all pairings run concurrently.  Each pairing
+ * plays an even split of games with either program moving first.
+ */
+template <typename Rules>
+class BasicTournament
+{
+public:
+    struct Standing {
+        Standing(std::string spec) : spec(spec), wins(0), losses(0), draws(0) { }
+
+        double points() const { return wins + 0.5 * draws; }
+
+        int games() const { return wins + losses + draws; }
+
+        std::string spec;
+        int wins, losses, draws;
+    };
+
+    BasicTournament(const std::vector<std::string> &specs,
+                    int games_per_pairing, bool gauntlet)
+        : _games_per_pairing(games_per_pairing)
+        , _games_out(nullptr)
+        , _records(nullptr)
+        , _ratings(nullptr)
+        , _cache(nullptr)
+    {
+        for (size_t i = 0; i != specs.size(); ++i)
+            _standings.push_back(Standing(specs[i]));
+        _latencies.resize(specs.size());
+        _usage.resize(specs.size());
+
+        for (size_t i = 0; i != specs.size(); ++i) {
+            for (size_t j = i + 1; j != specs.size(); ++j) {
+                if (gauntlet && i != 0)
+                    break;
+                for (int game = 0; game != games_per_pairing; ++game) {
+                    _pending.push_back(_jobs.size());
+                    if (game % 2 == 0)
+                        _jobs.push_back(Job(i, j));
+                    else
+                        _jobs.push_back(Job(j, i));
+                }
+            }
+        }
+    }
+
+    size_t num_games() const { return _jobs.size(); }
+
+    /** Games whose results were taken from the cache */
+    size_t num_cached() const { return _jobs.size() - _pending.size(); }
+
+    /** Writes every game as a JSON line to `out` when it is over */
+    void log_games(std::ostream &out) { _games_out = &out; }
+
+    /** Appends every game to a record file when it is over */
+    void record_games(RecordWriter &records) { _records = &records; }
+
+    /** Updates `ratings` with every game played when it is over */
+    void rate_games(Ratings &ratings) { _ratings = &ratings; }
+
+    /** Writes Metrics to `path` every few seconds while the games run */
+    void export_metrics(const std::string &path) { _metrics_path = path; }
+
+    /** Starts `depth` processes of every program ahead of their games */
+    void prestart(size_t depth) { _sessions.prestart(depth); }
+
+    /** Lets the programs play against a chess clock */
+    void time_control(const TimeControl &clock) { _clock = clock; }
+
+    /**
+     * Takes the results of pairings whose programs did not change from
+     * `cache`, and stores the results of all pairings there once the
+     * tournament has run.  Call after time_control().
+     */
+    void use_cache(ResultCache &cache) {
+        _cache = &cache;
+        _config = ResultCache::config<Rules>(_clock);
+        _hashes.clear();
+        for (size_t i = 0; i != _standings.size(); ++i)
+            _hashes.push_back(ResultCache::program_hash(_standings[i].spec));
+
+        // The games of a pairing are next to each other, see above
+        _pending.clear();
+        for (size_t first = 0; first != _jobs.size();
+                                    first += _games_per_pairing) {
+            const Job &job = _jobs[first];
+            std::string results;
+            if (!_hashes[job.a].empty() && !_hashes[job.b].empty()) {
+                results = _cache->find(_hashes[job.a], _hashes[job.b],
+                                       _config);
+            }
+            bool valid = results.size() == size_t(_games_per_pairing)
+                         && results.find_first_not_of("012") == std::string::npos;
+            for (int game = 0; game != _games_per_pairing; ++game) {
+                if (valid)
+                    _jobs[first + game].result = results[game] - '0';
+                else
+                    _pending.push_back(first + game);
+            }
+        }
+    }
+
+    void run(unsigned nworkers) {
+        _next_job = 0;
+        _start_metrics(std::max(nworkers, 1u));
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i != std::max(nworkers, 1u); ++i)
+            workers.push_back(std::thread(&BasicTournament::work, this, i));
+        for (size_t i = 0; i != workers.size(); ++i)
+            workers[i].join();
+        _metrics.reset();
+        tally();
+    }
+
+    /**
+     * Like run(), but plays up to `max_games` at once from this thread; only
+     * for the standard game.
+     */
+    void run_events(size_t max_games) {
+        _run_events(max_games, std::is_same<Rules, Standard>());
+    }
+
+    /** Response times of every program over all its games */
+    void print_latencies(std::ostream &out) const {
+        Latencies::print_header(out);
+        for (size_t i = 0; i != _standings.size(); ++i)
+            _latencies[i].print(out, _standings[i].spec);
+    }
+
+    /** Resources every program used over all its games */
+    void print_usage(std::ostream &out) const {
+        ResourceUsage::print_header(out);
+        for (size_t i = 0; i != _standings.size(); ++i)
+            _usage[i].print(out, _standings[i].spec);
+    }
+
+    void print_table(std::ostream &out) const {
+        std::vector<Standing> sorted(_standings);
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Standing &l, const Standing &r) {
+                             return l.points() > r.points();
+                         });
+
+        out << "Rang  Spiele  Siege  Niederl.  Unentsch.  Punkte  Programm\n";
+        for (size_t i = 0; i != sorted.size(); ++i) {
+            out << std::setw(4) << i + 1
+                << std::setw(8) << sorted[i].games()
+                << std::setw(7) << sorted[i].wins
+                << std::setw(10) << sorted[i].losses
+                << std::setw(11) << sorted[i].draws
+                << std::setw(8) << std::fixed << std::setprecision(1)
+                << sorted[i].points()
+                << "  " << sorted[i].spec << "\n";
+        }
+    }
+
+private:
+    struct Job {
+        Job(size_t a, size_t b) : a(a), b(b), result(-1) { }
+
+        size_t a, b;
+        int result;
+    };
+
+    void _start_metrics(unsigned nworkers) {
+        if (_metrics_path.empty())
+            return;
+        std::vector<std::string> specs;
+        for (size_t i = 0; i != _standings.size(); ++i)
+            specs.push_back(_standings[i].spec);
+        _metrics.reset(new Metrics(specs, nworkers, _sessions));
+        _metrics->schedule(_pending.size());
+        _metrics->export_to(_metrics_path);
+    }
+
+    void _run_events(size_t max_games, std::true_type) {
+        _start_metrics(1);
+        EventEngine engine(_sessions, max_games, _games_out, _records, _clock,
+                           _ratings, _metrics.get());
+        for (size_t k = 0; k != _pending.size(); ++k) {
+            Job &job = _jobs[_pending[k]];
+            engine.add(_standings[job.a].spec, _standings[job.b].spec,
+                       &job.result, &_latencies[job.a], &_latencies[job.b],
+                       &_usage[job.a], &_usage[job.b]);
+        }
+        engine.run();
+        _metrics.reset();
+        tally();
+    }
+
+    void _run_events(size_t, std::false_type) {
+        throw std::logic_error("EventEngine only plays the standard game");
+    }
+
+    /**
+     * Tallies the results only at the end, so games need not synchronize,
+     * and stores them in the cache.
+     */
+    void tally() {
+        if (_cache) {
+            for (size_t first = 0; first != _jobs.size();
+                                        first += _games_per_pairing) {
+                std::string results;
+                for (int game = 0; game != _games_per_pairing; ++game)
+                    results += char('0' + _jobs[first + game].result);
+                const Job &job = _jobs[first];
+                if (results.find_first_not_of("012") == std::string::npos
+                        && !_hashes[job.a].empty() && !_hashes[job.b].empty()) {
+                    _cache->store(_hashes[job.a], _hashes[job.b], _config,
+                                  results);
+                }
+            }
+        }
+        for (size_t i = 0; i != _jobs.size(); ++i) {
+            Standing &a = _standings[_jobs[i].a], &b = _standings[_jobs[i].b];
+            switch (_jobs[i].result) {
+            case 1:
+                ++a.wins;
+                ++b.losses;
+                break;
+            case 2:
+                ++a.losses;
+                ++b.wins;
+                break;
+            default:
+                ++a.draws;
+                ++b.draws;
+            }
+        }
+    }
+
+    void work(unsigned worker) {
+        GameLog log;
+        for (;;) {
+            size_t current = _next_job++;
+            if (current >= _pending.size())
+                break;
+
+            Job &job = _jobs[_pending[current]];
+            const std::string &spec_a = _standings[job.a].spec;
+            const std::string &spec_b = _standings[job.b].spec;
+            if (_metrics)
+                _metrics->started(worker);
+            job.result = _sessions.play<Rules>(spec_a, spec_b, log, _clock);
+            if (_metrics)
+                _metrics->finished(worker, spec_a, spec_b, log);
+            {
+                std::lock_guard<std::mutex> lock(_latencies_mutex);
+                _latencies[job.a].merge(log.latencies(0));
+                _latencies[job.b].merge(log.latencies(1));
+                _usage[job.a].merge(log.usage(0));
+                _usage[job.b].merge(log.usage(1));
+            }
+            if (_games_out) {
+                std::lock_guard<std::mutex> lock(_games_mutex);
+                log.write(*_games_out, spec_a, spec_b, job.result);
+            }
+            if (_records || _ratings) {
+                // rated in the order of the records, so that a replay of
+                // them rebuilds the same ratings
+                std::lock_guard<std::mutex> lock(_records_mutex);
+                if (_records) {
+                    GameRecord record;
+                    log.fill(record, spec_a, spec_b, job.result);
+                    _records->append(record);
+                }
+                if (_ratings)
+                    _ratings->add(spec_a, spec_b, job.result);
+            }
+        }
     }
-    if (!me.alive())
-        me.send('L');
-    else if (!other.alive())
-        me.send('W');
-    else
-        me.send(outcomechar[treffer]);
-}
 
-extern "C" void signal_handler(int)
+    std::vector<Standing> _standings;
+    std::vector<Job> _jobs;
+    std::vector<size_t> _pending;           // indices of jobs to play
+    int _games_per_pairing;
+    std::atomic<size_t> _next_job;
+    SessionPool _sessions;
+    TimeControl _clock;
+    std::ostream *_games_out;
+    std::mutex _games_mutex;
+    RecordWriter *_records;
+    Ratings *_ratings;
+    std::mutex _records_mutex;      // for both, see work()
+    std::vector<Latencies> _latencies;
+    std::vector<ResourceUsage> _usage;
+    std::mutex _latencies_mutex;
+    ResultCache *_cache;
+    std::string _config;
+    std::vector<std::string> _hashes;       // of each program, for the cache
+    std::string _metrics_path;
+    std::unique_ptr<Metrics> _metrics;
+};
+
+typedef BasicTournament<Standard> Tournament;
+
+/** Prints `ratings` to `out` and saves them to `path`; false if it fails */
+bool save_ratings(const Ratings &ratings, const std::string &path,
+                  std::ostream &out)
 {
-    // Kill children and close associated pipes
-    // std::quick_exit is not available on OSX - thanks Lorenz for finding this out!
-    Registered<ChildProcess>::cleanup();
-    _Exit(99);
+    out << "\n";
+    ratings.print(out);
+    try {
+        ratings.save(path);
+    } catch(const std::runtime_error &e) {
+        std::cerr << "Fehler: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
 }
 
-int main(int argc, char *argv[])
+template <typename Rules>
+int run_tournament(const std::vector<std::string> &args,
+                   const TimeControl &clock)
 {
-    // register signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
-    signal(SIGHUP, signal_handler);
-
-    // handle arguments
-    std::vector<std::string> args(argv, argv + argc);
-    if (args.size() != 3) {
+    std::vector<std::string> specs;
+    int games_per_pairing = 2;
+    unsigned nworkers = 0;
+    int prestarted = 0;
+    bool gauntlet = false, events = false, headless = false;
+    std::string record_path, cache_path, ratings_path, metrics_path;
+    for (size_t i = 2; i != args.size(); ++i) {
+        if ((args[i] == "-n" || args[i] == "-j") && i + 1 != args.size()) {
+            int value = atoi(args[i+1].c_str());
+            if (value <= 0) {
+                print_usage(args[0]);
+                return 3;
+            }
+            if (args[i] == "-n")
+                games_per_pairing = value;
+            else
+                nworkers = value;
+            ++i;
+        } else if (args[i] == "--vorstart" && i + 1 != args.size()) {
+            prestarted = atoi(args[++i].c_str());
+        } else if (args[i] == "--gauntlet") {
+            gauntlet = true;
+        } else if (args[i] == "--epoll") {
+            events = true;
+        } else if (args[i] == "--leise") {
+            headless = true;
+        } else if (args[i] == "--aufzeichnung" && i + 1 != args.size()) {
+            record_path = args[++i];
+        } else if (args[i] == "--ergebnisse" && i + 1 != args.size()) {
+            cache_path = args[++i];
+        } else if (args[i] == "--wertung" && i + 1 != args.size()) {
+            ratings_path = args[++i];
+        } else if (args[i] == "--metriken" && i + 1 != args.size()) {
+            metrics_path = args[++i];
+        } else if (args[i][0] == '-') {
+            print_usage(args[0]);
+            return 3;
+        } else if (args[i].find('/') == std::string::npos) {
+            std::cerr << "Fehler: Programm '" << args[i]
+                      << "' muss ausfuehrbarer Pfad sein.\n";
+            return 3;
+        } else {
+            specs.push_back(args[i]);
+        }
+    }
+    if (specs.size() < 2) {
         print_usage(args[0]);
         return 3;
     }
+    if (!std::is_same<Rules, Standard>::value
+        && (events || !record_path.empty())) {
+        std::cerr << "Fehler: --epoll und --aufzeichnung gibt es nur im "
+                     "Standardspiel.\n";
+        return 3;
+    }
+    if (events && std::count_if(specs.begin(), specs.end(),
+                                SocketBot::is_spec) != 0) {
+        std::cerr << "Fehler: --epoll gibt es nicht mit Bot-Servern.\n";
+        return 3;
+    }
+    if (events && ChildProcess::shared_memory()) {
+        std::cerr << "Fehler: --epoll gibt es nicht mit --shm.\n";
+        return 3;
+    }
+    for (size_t i = 0; i != specs.size(); ++i) {
+        try {
+            if (PluginBot::is_spec(specs[i])) {
+                const PluginLibrary &library =
+                                    PluginLibrary::load(specs[i].substr(4));
+                if (!library.plays(GameVariant::of<Rules>())) {
+                    throw std::runtime_error("Plugin '" + specs[i].substr(4)
+                            + "' kennt keine Varianten "
+                              "(spieler_neu_variante fehlt)");
+                }
+            } else if (SocketBot::is_spec(specs[i])) {
+                BotConnection::get(specs[i].substr(5));
+            }
+        } catch(const std::runtime_error &e) {
+            std::cerr << "Fehler: " << e.what() << std::endl;
+            return 3;
+        }
+    }
 
-    // create players
-    Player player_a, player_b;
+    // A crashed program must not take the referee with it: instead, the
+    // failing write counts as an illegal action of that program.
+    signal(SIGPIPE, SIG_IGN);
+
+    // Every program takes two pipes: allow as many as we may
+    rlimit files;
+    if (getrlimit(RLIMIT_NOFILE, &files) == 0 && files.rlim_cur < files.rlim_max) {
+        files.rlim_cur = files.rlim_max;
+        monitored(setrlimit(RLIMIT_NOFILE, &files));
+    }
+
+    BasicTournament<Rules> tournament(specs, games_per_pairing, gauntlet);
+    if (headless)
+        tournament.log_games(std::cout);
+    if (prestarted > 0)
+        tournament.prestart(prestarted);
+    if (!metrics_path.empty())
+        tournament.export_metrics(metrics_path);
+    tournament.time_control(clock);
+    std::unique_ptr<RecordWriter> records;
+    std::unique_ptr<ResultCache> cache;
+    Ratings ratings;
     try {
-        player_a = make_player(args[1], 'A');
-        player_b = make_player(args[2], 'B');
+        if (!record_path.empty()) {
+            records.reset(new RecordWriter(record_path));
+            tournament.record_games(*records);
+        }
+        if (!cache_path.empty()) {
+            cache.reset(new ResultCache(cache_path));
+            tournament.use_cache(*cache);
+        }
+        if (!ratings_path.empty()) {
+            ratings.load(ratings_path);
+            tournament.rate_games(ratings);
+        }
     } catch(const std::runtime_error &e) {
         std::cerr << "Fehler: " << e.what() << std::endl;
         return 3;
     }
+    size_t played = tournament.num_games() - tournament.num_cached();
+    if (nworkers == 0)
+        nworkers = events ? 64 : std::thread::hardware_concurrency();
+    if (cache) {
+        std::cerr << "Turnier: " << tournament.num_cached() << " von "
+                  << tournament.num_games() << " Spielen aus '" << cache_path
+                  << "' uebernommen\n";
+    }
+    if (events) {
+        std::cerr << "Turnier: " << played << " Spiele, bis zu "
+                  << nworkers << " gleichzeitig in einem Thread ...\n";
+    } else {
+        std::cerr << "Turnier: " << played << " Spiele auf "
+                  << nworkers << " Threads ...\n";
+    }
 
-    // placement phase
-    std::cerr << "\nSpieler A setzt Schiffe:\n";
+    std::chrono::steady_clock::time_point start =
+                                    std::chrono::steady_clock::now();
+    if (events)
+        tournament.run_events(nworkers);
+    else
+        tournament.run(nworkers);
+    double seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+
+    // In headless mode, stdout is reserved for the games
+    tournament.print_table(headless ? std::cerr : std::cout);
+    std::cerr << "\n";
+    tournament.print_latencies(std::cerr);
+    std::cerr << "\n";
+    tournament.print_usage(std::cerr);
+    std::cerr << played << " Spiele in " << std::fixed
+              << std::setprecision(2) << seconds << " s ("
+              << played / seconds << " Spiele/s)\n";
+    if (!ratings_path.empty() && !save_ratings(ratings, ratings_path, std::cerr))
+        return 1;
+    if (cache) {
+        try {
+            cache->save();
+        } catch(const std::runtime_error &e) {
+            std::cerr << "Fehler: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Match of a candidate against a champion that stops as soon as a sequential
+ * probability ratio test (SPRT) decides between H0, "the candidate is elo0
+ * stronger", and H1, "it is elo1 stronger", at error rates alpha and beta.
+ *
+ * The log-likelihood ratio uses the usual normal approximation on the
+ * mean and variance of the candidate's score per game.  The candidate plays
+ * as A in every other game, since A shoots first.  Games enter the test in
+ * the order they were started, so the decision does not depend on which
+ * thread is faster; games still running when it falls are not counted.
+ */
+template <typename Rules>
+class Match
+{
+public:
+    enum Decision {
+        UNDECIDED, H0, H1
+    };
+
+    Match(const std::string &candidate, const std::string &champion,
+          double elo0, double elo1, double alpha, double beta, int max_games)
+        : _candidate(candidate), _champion(champion)
+        , _score0(_expected_score(elo0)), _score1(_expected_score(elo1))
+        , _lower(std::log(beta / (1 - alpha)))
+        , _upper(std::log((1 - beta) / alpha))
+        , _max_games(max_games), _wins(0), _losses(0), _draws(0)
+        , _decided_after(0), _played(0), _decision(UNDECIDED), _games_out(nullptr), _records(nullptr)
+        , _ratings(nullptr)
+    { }
+
+    /** Writes every game as a JSON line to `out` when it is over */
+    void log_games(std::ostream &out) { _games_out = &out; }
+
+    /** Appends every game to a record file when it is over */
+    void record_games(RecordWriter &records) { _records = &records; }
+
+    /** Updates `ratings` with every game when it is over */
+    void rate_games(Ratings &ratings) { _ratings = &ratings; }
+
+    /** Starts `depth` processes of every program ahead of their games */
+    void prestart(size_t depth) { _sessions.prestart(depth); }
+
+    /** Lets the programs play against a chess clock */
+    void time_control(const TimeControl &clock) { _clock = clock; }
+
+    /** Plays games on `nworkers` threads until the test decides */
+    void run(unsigned nworkers) {
+        _next_game = 0;
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i != std::max(nworkers, 1u); ++i)
+            workers.push_back(std::thread(&Match::work, this));
+        for (size_t i = 0; i != workers.size(); ++i)
+            workers[i].join();
+    }
+
+    Decision decision() const { return _decision; }
+
+    /** Games that count for the test */
+    int games() const { return _wins + _losses + _draws; }
+
+    /** Games played, including those that ended after the decision */
+    int played() const { return _played; }
+
+    void print_result(std::ostream &out) const {
+        out << std::fixed << std::setprecision(2);
+        switch (_decision) {
+        case H1:
+            out << _candidate << " ist staerker als " << _champion
+                << " (H1 angenommen nach " << _decided_after << " Spielen)\n";
+            break;
+        case H0:
+            out << _candidate << " ist nicht staerker als " << _champion
+                << " (H0 angenommen nach " << _decided_after << " Spielen)\n";
+            break;
+        default:
+            out << "Nach " << games() << " Spielen keine Entscheidung\n";
+        }
+
+        double score, variance;
+        _statistics(score, variance);
+        double error = 1.96 * std::sqrt(variance / (games() + 1));
+        out << "Spiele: " << this->games() << " (" << _wins << " Siege, "
+            << _losses << " Niederlagen, " << _draws << " Unentschieden)\n"
+            << "Punkte: " << std::setprecision(3) << score << " +- " << error
+            << " (95%)\n"
+            << "Elo:    " << std::setprecision(1) << _elo(score) << " ["
+            << _elo(score - error) << ", " << _elo(score + error) << "]\n"
+            << "P(staerker): " << std::setprecision(3)
+            << _likelihood_of_superiority() << "\n"
+            << "LLR:    " << std::setprecision(2) << _llr() << " [" << _lower
+            << ", " << _upper << "]\n";
+    }
+
+    void print_latencies(std::ostream &out) const {
+        Latencies::print_header(out);
+        _latencies[0].print(out, _candidate);
+        _latencies[1].print(out, _champion);
+    }
+
+    void print_usage(std::ostream &out) const {
+        ResourceUsage::print_header(out);
+        _usage[0].print(out, _candidate);
+        _usage[1].print(out, _champion);
+    }
+
+private:
+    static double _expected_score(double elo) {
+        return 1 / (1 + std::pow(10, -elo / 400));
+    }
+
+    static double _elo(double score) {
+        score = std::min(std::max(score, 0.001), 0.999);
+        return 400 * std::log10(score / (1 - score));
+    }
+
+    /**
+     * Mean and variance of the score of the candidate in a game.  Half a win
+     * and half a loss are added, so that a clean sweep still has a variance
+     * (and a finite Elo).
+     */
+    void _statistics(double &score, double &variance) const {
+        double games = this->games() + 1;
+        score = (_wins + 0.5 + 0.5 * _draws) / games;
+        variance = (_wins + 0.5 + 0.25 * _draws) / games - score * score;
+    }
+
+    double _llr() const {
+        double score, variance;
+        _statistics(score, variance);
+        return (games() + 1) * (_score1 - _score0)
+               * (2 * score - _score0 - _score1) / (2 * variance);
+    }
+
+    double _likelihood_of_superiority() const {
+        if (_wins + _losses == 0)
+            return 0.5;
+        return 0.5 * (1 + std::erf((_wins - _losses)
+                                   / std::sqrt(2.0 * (_wins + _losses))));
+    }
+
+    void work() {
+        GameLog log;
+        for (;;) {
+            int game = _next_game++;
+            if (game >= _max_games || _decision != UNDECIDED)
+                break;
+
+            bool swapped = game % 2 != 0;
+            const std::string &spec_a = swapped ? _champion : _candidate;
+            const std::string &spec_b = swapped ? _candidate : _champion;
+            int result = _sessions.play<Rules>(spec_a, spec_b, log, _clock);
+
+            std::lock_guard<std::mutex> lock(_mutex);
+            ++_played;
+            _unscored[game] = result == 0 ? 1 : (result == 1) != swapped ? 2 : 0;
+            _latencies[swapped].merge(log.latencies(0));
+            _latencies[!swapped].merge(log.latencies(1));
+            _usage[swapped].merge(log.usage(0));
+            _usage[!swapped].merge(log.usage(1));
+            if (_games_out)
+                log.write(*_games_out, spec_a, spec_b, result);
+            if (_records) {
+                GameRecord record;
+                log.fill(record, spec_a, spec_b, result);
+                _records->append(record);
+            }
+            if (_ratings)
+                _ratings->add(spec_a, spec_b, result);
+
+            // games() is the number of the next game to score
+            std::map<int, int>::iterator next;
+            while (_decision == UNDECIDED
+                   && (next = _unscored.find(games())) != _unscored.end()) {
+                if (next->second == 1)
+                    ++_draws;
+                else if (next->second == 2)
+                    ++_wins;
+                else
+                    ++_losses;
+                _unscored.erase(next);
+
+                double llr = _llr();
+                if (llr >= _upper)
+                    _decision = H1;
+                else if (llr <= _lower)
+                    _decision = H0;
+                if (_decision != UNDECIDED)
+                    _decided_after = games();
+                if (games() % 100 == 0 || _decision != UNDECIDED) {
+                    std::cerr << std::setw(6) << games() << " Spiele: +"
+                              << _wins << " -" << _losses << " =" << _draws
+                              << "  LLR " << std::fixed << std::setprecision(2)
+                              << llr << "\n";
+                }
+            }
+        }
+    }
+
+    std::string _candidate, _champion;
+    double _score0, _score1, _lower, _upper;
+    int _max_games;
+    std::atomic<int> _next_game;
+    SessionPool _sessions;
+    TimeControl _clock;
+    std::mutex _mutex;
+    int _wins, _losses, _draws, _decided_after, _played;
+    std::map<int, int> _unscored;   // points of the candidate by game number
+    std::atomic<Decision> _decision;
+    std::ostream *_games_out;
+    RecordWriter *_records;
+    Ratings *_ratings;
+    Latencies _latencies[2];
+    ResourceUsage _usage[2];
+};
+
+template <typename Rules>
+int run_match(const std::vector<std::string> &args, const TimeControl &clock)
+{
+    std::vector<std::string> specs;
+    double elo0 = 0, elo1 = 10, alpha = 0.05, beta = 0.05;
+    int max_games = 20000;
+    unsigned nworkers = 0;
+    int prestarted = 0;
+    bool headless = false;
+    std::string record_path, ratings_path;
+    for (size_t i = 2; i != args.size(); ++i) {
+        if ((args[i] == "-n" || args[i] == "-j") && i + 1 != args.size()) {
+            int value = atoi(args[i+1].c_str());
+            if (value <= 0) {
+                print_usage(args[0]);
+                return 3;
+            }
+            if (args[i] == "-n")
+                max_games = value;
+            else
+                nworkers = value;
+            ++i;
+        } else if (args[i] == "--vorstart" && i + 1 != args.size()) {
+            prestarted = atoi(args[++i].c_str());
+        } else if ((args[i] == "--elo0" || args[i] == "--elo1"
+                    || args[i] == "--alpha" || args[i] == "--beta")
+                   && i + 1 != args.size()) {
+            double value = atof(args[i+1].c_str());
+            if (args[i] == "--elo0")
+                elo0 = value;
+            else if (args[i] == "--elo1")
+                elo1 = value;
+            else if (args[i] == "--alpha")
+                alpha = value;
+            else
+                beta = value;
+            ++i;
+        } else if (args[i] == "--leise") {
+            headless = true;
+        } else if (args[i] == "--aufzeichnung" && i + 1 != args.size()) {
+            record_path = args[++i];
+        } else if (args[i] == "--wertung" && i + 1 != args.size()) {
+            ratings_path = args[++i];
+        } else if (args[i][0] == '-') {
+            print_usage(args[0]);
+            return 3;
+        } else if (args[i].find('/') == std::string::npos) {
+            std::cerr << "Fehler: Programm '" << args[i]
+                      << "' muss ausfuehrbarer Pfad sein.\n";
+            return 3;
+        } else {
+            specs.push_back(args[i]);
+        }
+    }
+    if (specs.size() != 2) {
+        print_usage(args[0]);
+        return 3;
+    }
+    if (!(elo0 < elo1) || !(alpha > 0 && alpha < 1) || !(beta > 0 && beta < 1)) {
+        std::cerr << "Fehler: es muss ELO0 < ELO1 und 0 < ALPHA, BETA < 1 "
+                     "gelten.\n";
+        return 3;
+    }
+    if (!std::is_same<Rules, Standard>::value && !record_path.empty()) {
+        std::cerr << "Fehler: --aufzeichnung gibt es nur im Standardspiel.\n";
+        return 3;
+    }
+    for (size_t i = 0; i != specs.size(); ++i) {
+        try {
+            if (PluginBot::is_spec(specs[i])) {
+                const PluginLibrary &library =
+                                    PluginLibrary::load(specs[i].substr(4));
+                if (!library.plays(GameVariant::of<Rules>())) {
+                    throw std::runtime_error("Plugin '" + specs[i].substr(4)
+                            + "' kennt keine Varianten "
+                              "(spieler_neu_variante fehlt)");
+                }
+            } else if (SocketBot::is_spec(specs[i])) {
+                BotConnection::get(specs[i].substr(5));
+            }
+        } catch(const std::runtime_error &e) {
+            std::cerr << "Fehler: " << e.what() << std::endl;
+            return 3;
+        }
+    }
+
+    // As in a tournament: a crashed program loses the game
+    signal(SIGPIPE, SIG_IGN);
+
+    Match<Rules> match(specs[0], specs[1], elo0, elo1, alpha, beta,
+                       max_games);
+    if (headless)
+        match.log_games(std::cout);
+    if (prestarted > 0)
+        match.prestart(prestarted);
+    match.time_control(clock);
+    std::unique_ptr<RecordWriter> records;
+    Ratings ratings;
     try {
-        place(player_a);
+        if (!record_path.empty()) {
+            records.reset(new RecordWriter(record_path));
+            match.record_games(*records);
+        }
+        if (!ratings_path.empty()) {
+            ratings.load(ratings_path);
+            match.rate_games(ratings);
+        }
     } catch(const std::runtime_error &e) {
-        std::cerr << "\n\n" << e.what()
-                  << "\nSpieler B hat gewonnen! (Illegale Platzierung von A)\n";
+        std::cerr << "Fehler: " << e.what() << std::endl;
+        return 3;
+    }
+    if (nworkers == 0)
+        nworkers = std::thread::hardware_concurrency();
+    std::cerr << "Duell: " << specs[0] << " gegen " << specs[1] << ", H0: "
+              << elo0 << " Elo, H1: " << elo1 << " Elo, bis zu " << max_games
+              << " Spiele auf " << nworkers << " Threads ...\n";
+
+    std::chrono::steady_clock::time_point start =
+                                    std::chrono::steady_clock::now();
+    match.run(nworkers);
+    double seconds = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start).count();
+
+    std::ostream &out = headless ? std::cerr : std::cout;
+    out << "\n";
+    match.print_result(out);
+    std::cerr << "\n";
+    match.print_latencies(std::cerr);
+    std::cerr << "\n";
+    match.print_usage(std::cerr);
+    std::cerr << match.played() << " Spiele in " << std::fixed
+              << std::setprecision(2) << seconds << " s\n";
+    if (!ratings_path.empty() && !save_ratings(ratings, ratings_path, std::cerr))
+        return 3;
+    switch (match.decision()) {
+    case Match<Rules>::H1:
+        return 0;
+    case Match<Rules>::H0:
+        return 1;
+    default:
         return 2;
     }
-    std::cerr << "\nSpieler B setzt Schiffe:\n";
+}
+
+/**
+ * Plays a recorded game again on empty boards and draws the final position.
+ * Returns false if the moves do not fit the rules, i.e., the record is corrupt.
+ */
+bool replay_game(const GameRecord &record, std::ostream &out)
+{
+    Player players[2] = {Player('A'), Player('B')};
     try {
-        place(player_b);
+        for (int which = 0; which != 2; ++which) {
+            for (int ship = 0;
+                    ship < std::min<int>(record.nships[which], Standard::nships);
+                    ++ship) {
+                int field = record.ships[which][ship] % GameRecord::DOWNWARD;
+                players[which].place(field / Standard::cols,
+                                     field % Standard::cols,
+                                     Standard::ship_sizes[ship],
+                                     record.ships[which][ship]
+                                     >= GameRecord::DOWNWARD);
+            }
+        }
+        for (int k = 0; k < std::min<int>(record.nshots, GameRecord::MAX_SHOTS);
+                ++k) {
+            int field = record.shot_field[k];
+            int by_b = (record.shot_outcome[k] & GameRecord::SHOT_BY_B) != 0;
+            int outcome = record.shot_outcome[k] & ~GameRecord::SHOT_BY_B;
+            if (players[1 - by_b].incoming(field / Standard::cols,
+                                           field % Standard::cols) != outcome)
+                return false;
+        }
     } catch(const std::runtime_error &e) {
-        std::cerr << "\n\n" << e.what()
-                  << "\nSpieler A hat gewonnen! (Illegale Platzierung von B)\n";
-        return 1;
+        return false;
     }
+    print_boards(out, players[0], players[1], true);
+    return true;
+}
 
-    std::cerr << "\nLos gehts!\n";
-    // shootout phase
-    for (int move = 1; player_a.alive() && player_b.alive(); ++move) {
-        if (move == 101) {
-            std::cerr << "100 Züge gespielt - das ist genug.\n";
-            player_a.die();
-            player_b.die();
-            break;
+int run_replay(const std::vector<std::string> &args)
+{
+    static const char *result_name[] = {"unentschieden", "A gewinnt",
+                                        "B gewinnt"};
+
+    std::string path, spec, ratings_path;
+    int result = -1;
+    size_t number = 0;
+    const char *reason = nullptr;
+    bool show = false;
+    for (size_t i = 2; i != args.size(); ++i) {
+        if (args[i] == "--programm" && i + 1 != args.size()) {
+            spec = args[++i];
+        } else if (args[i] == "--ergebnis" && i + 1 != args.size()) {
+            result = atoi(args[++i].c_str());
+        } else if (args[i] == "--grund" && i + 1 != args.size()) {
+            for (int k = 0; k != GameLog::NREASONS; ++k) {
+                if (args[i+1] == GameLog::reason_name(k))
+                    reason = GameLog::reason_name(k);
+            }
+            if (!reason) {
+                print_usage(args[0]);
+                return 3;
+            }
+            ++i;
+        } else if (args[i] == "--spiel" && i + 1 != args.size()) {
+            number = atol(args[++i].c_str());
+        } else if (args[i] == "--zeigen") {
+            show = true;
+        } else if (args[i] == "--wertung" && i + 1 != args.size()) {
+            ratings_path = args[++i];
+        } else if (args[i][0] == '-' || !path.empty()) {
+            print_usage(args[0]);
+            return 3;
+        } else {
+            path = args[i];
         }
-        std::cerr << "Zug " << std::setw(3) << move << ": ";
-        try {
-            shoot(player_a, player_b);
-        } catch(const std::runtime_error &e) {
-            std::cerr << "\n\n" << e.what() << "\nIllegale Aktion von A\n";
-            player_a.die();
-            break;
+    }
+    if (path.empty()) {
+        print_usage(args[0]);
+        return 3;
+    }
+
+    try {
+        RecordReader records(path);
+        Ratings ratings;
+        size_t matching = 0, corrupt = 0, results[3] = {0, 0, 0};
+        for (size_t i = 0; i != records.size(); ++i) {
+            const GameRecord &record = records[i];
+            if (!record.valid() || record.result > 2) {
+                ++corrupt;
+                continue;
+            }
+            if ((number != 0 && i + 1 != number)
+                    || (result >= 0 && record.result != result)
+                    || (reason && GameLog::reason_name(record.reason) != reason)
+                    || (!spec.empty() && !record.plays(spec)))
+                continue;
+
+            ++matching;
+            ++results[record.result];
+            if (!ratings_path.empty()) {
+                ratings.add(record);
+                continue;
+            }
+            std::cout << i + 1 << "\t" << result_name[record.result] << "\t"
+                      << GameLog::reason_name(record.reason) << "\t"
+                      << (record.nshots + 1) / 2 << "\t"
+                      << std::string(record.spec[0], strnlen(record.spec[0],
+                                                GameRecord::SPEC_SIZE)) << "\t"
+                      << std::string(record.spec[1], strnlen(record.spec[1],
+                                                GameRecord::SPEC_SIZE)) << "\n";
+            if (show && !replay_game(record, std::cout)) {
+                std::cout << "Aufzeichnung ist beschaedigt.\n";
+                ++corrupt;
+            }
         }
-        try {
-            shoot(player_b, player_a);
-        } catch(const std::runtime_error &e) {
-            std::cerr << "\n\n" << e.what() << "\nIllegaler Aktion von B\n";
-            player_b.die();
+        std::cerr << matching << " von " << records.size() << " Spielen: "
+                  << results[1] << "x A, " << results[2] << "x B, "
+                  << results[0] << "x unentschieden";
+        if (corrupt != 0)
+            std::cerr << ", " << corrupt << " beschaedigt";
+        std::cerr << "\n";
+        if (!ratings_path.empty() && !save_ratings(ratings, ratings_path,
+                                                   std::cout))
+            return 3;
+    } catch(const std::runtime_error &e) {
+        std::cerr << "Fehler: " << e.what() << std::endl;
+        return 3;
+    }
+    return 0;
+}
+
+extern "C" void signal_handler(int)
+{
+    // Kill children; their pipes are closed as we exit.  Only async-signal-
+    // safe functions may be called here, so the message is put together by
+    // hand.
+    // std::quick_exit is not available on OSX - thanks Lorenz for finding this out!
+    size_t ncleaned = ChildRegistry::kill_all();
+    if (ncleaned) {
+        char message[40] = "Cleaned ";
+        char digits[20];
+        int ndigits = 0, length = 8;
+        for (; ncleaned != 0; ncleaned /= 10)
+            digits[ndigits++] = '0' + ncleaned % 10;
+        while (ndigits != 0)
+            message[length++] = digits[--ndigits];
+        memcpy(message + length, " objects\n", 9);
+        if (write(STDERR_FILENO, message, length + 9) < 0)
+            _Exit(99);
+    }
+    _Exit(99);
+}
+
+/** A single game, shown on the terminal or written as a JSON line */
+template <typename Rules>
+int run_game(std::vector<std::string> args, const TimeControl &clock)
+{
+    bool headless = false;
+    std::string record_path;
+    while (args.size() >= 2 && args[1].compare(0, 2, "--") == 0) {
+        if (args[1] == "--leise") {
+            headless = true;
+        } else if (args[1] == "--aufzeichnung" && args.size() >= 3) {
+            record_path = args[2];
+            args.erase(args.begin() + 2);
+        } else {
             break;
         }
+        args.erase(args.begin() + 1);
+    }
+    if (args.size() != 3) {
+        print_usage(args[0]);
+        return 3;
+    }
+    if (headless && (args[1] == "mensch" || args[2] == "mensch")) {
+        std::cerr << "Fehler: ohne Ausgabe koennen nur Programme spielen.\n";
+        return 3;
+    }
+    if (!std::is_same<Rules, Standard>::value && !record_path.empty()) {
+        std::cerr << "Fehler: --aufzeichnung gibt es nur im Standardspiel.\n";
+        return 3;
     }
 
-    // scoring
-    print_boards(std::cerr, player_a, player_b, true);
-    if (player_a.alive()) {
-        std::cerr << "Spieler A hat gewonnen!\n";
-        return 1;
-    } else if (player_b.alive()) {
-        std::cerr << "Spieler B hat gewonnen!\n";
-        return 2;
+    // create players
+    std::ostream quiet(nullptr);
+    std::ostream &out = headless ? quiet : std::cerr;
+    BasicPlayer<Rules> player_a, player_b;
+    std::unique_ptr<RecordWriter> records;
+    try {
+        if (!record_path.empty())
+            records.reset(new RecordWriter(record_path));
+        player_a = make_player<Rules>(args[1], 'A', out);
+        player_b = make_player<Rules>(args[2], 'B', out);
+    } catch(const std::runtime_error &e) {
+        std::cerr << "Fehler: " << e.what() << std::endl;
+        return 3;
+    }
+
+    GameLog log;
+    int result = play_game(player_a, player_b, out, &log, clock);
+    log.usage(0) = player_a.take_usage(false);
+    log.usage(1) = player_b.take_usage(false);
+    if (headless) {
+        log.write(std::cout, args[1], args[2], result);
     } else {
-        std::cerr << "Unentschieden ...\n";
-        return 0;
+        out << "\n";
+        Latencies::print_header(out);
+        log.latencies(0).print(out, "Spieler A");
+        log.latencies(1).print(out, "Spieler B");
+        if (log.usage(0).games || log.usage(1).games) {
+            out << "\n";
+            ResourceUsage::print_header(out);
+            log.usage(0).print(out, "Spieler A");
+            log.usage(1).print(out, "Spieler B");
+        }
+    }
+    if (records) {
+        GameRecord record;
+        log.fill(record, args[1], args[2], result);
+        records->append(record);
+    }
+    return result;
+}
+
+/** Runs the mode given on the command line in variant `Rules` */
+template <typename Rules>
+int run_mode(const std::vector<std::string> &args, const TimeControl &clock)
+{
+    ChildProcess::variant() = GameVariant::of<Rules>();
+    if (args.size() >= 2 && args[1] == "--turnier")
+        return run_tournament<Rules>(args, clock);
+    if (args.size() >= 2 && args[1] == "--duell")
+        return run_match<Rules>(args, clock);
+    return run_game<Rules>(args, clock);
+}
+
+#ifndef SCHIFFE_VERSENKEN_NO_MAIN
+int main(int argc, char *argv[])
+{
+    // register signal handlers
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    signal(SIGHUP, signal_handler);
+
+    // handle arguments; the variant, clock and limits may be given anywhere
+    std::vector<std::string> args(argv, argv + argc);
+    std::string variant = "standard";
+    TimeControl clock;
+    for (size_t i = 1; i < args.size(); ) {
+        if (args[i] == "--variante" && i + 1 != args.size()) {
+            variant = args[i+1];
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else if (args[i] == "--zeit" && i + 1 != args.size()) {
+            if (!TimeControl::parse(args[i+1], clock)) {
+                std::cerr << "Fehler: ungueltige Bedenkzeit '" << args[i+1]
+                          << "'.\n";
+                return 3;
+            }
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else if (args[i] == "--restzeit") {
+            clock.announce = true;
+            args.erase(args.begin() + i);
+        } else if ((args[i] == "--cpu-grenze" || args[i] == "--speicher-grenze")
+                   && i + 1 != args.size()) {
+            int value = atoi(args[i+1].c_str());
+            if (value <= 0) {
+                print_usage(args[0]);
+                return 3;
+            }
+            if (args[i] == "--cpu-grenze")
+                ChildProcess::limits().cpu_s = value;
+            else
+                ChildProcess::limits().memory_mb = value;
+            args.erase(args.begin() + i, args.begin() + i + 2);
+        } else if (args[i] == "--shm") {
+            ChildProcess::shared_memory() = true;
+            args.erase(args.begin() + i);
+        } else {
+            ++i;
+        }
+    }
+    if (clock.announce && !clock.enabled()) {
+        std::cerr << "Fehler: --restzeit gibt es nur mit --zeit.\n";
+        return 3;
+    }
+    if (args.size() >= 2 && args[1] == "--wiedergabe") {
+        if (variant != "standard") {
+            std::cerr << "Fehler: Aufzeichnungen gibt es nur im "
+                         "Standardspiel.\n";
+            return 3;
+        }
+        return run_replay(args);
     }
+    if (variant == "standard")
+        return run_mode<Standard>(args, clock);
+    if (variant == "gemischt")
+        return run_mode<Mixed>(args, clock);
+    if (variant == "gross")
+        return run_mode<Large>(args, clock);
+    std::cerr << "Fehler: unbekannte Variante '" << variant << "'.\n";
+    return 3;
 }
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Schnittstelle fuer Spieler-Plugins von "Schiffe versenken".
+ *
+ * Statt als eigenes Programm, das ueber stdin/stdout spielt, kann ein Spieler
+ * auch als Bibliothek vorliegen, die der Schiedsrichter mit dlopen() laedt:
+ *
+ *     g++ -shared -fPIC -o meine_ki.so meine_ki.cpp
+ *     ./schiffe_versenken lib:./meine_ki.so ./andere_ki
+ *
+ * Die Bibliothek muss die unten deklarierten Funktionen exportieren.  Jedes
+ * Spiel bekommt mit spieler_neu() einen eigenen Zustand; im Turnier laufen
+ * mehrere Spiele gleichzeitig in verschiedenen Threads, daher darf ein Plugin
+ * keine globalen Variablen veraendern.
+ *
+ * Mit spieler_programm.cpp wird aus derselben Bibliothek auch ein normales
+ * Spieler-Programm, so dass sich beide Wege vergleichen lassen.
+ *
+ * Varianten des Spiels (--variante) spielt nur ein Plugin, das auch
+ * spieler_neu_variante() exportiert; alle anderen Funktionen bleiben gleich.
+ */
+#ifndef SPIELER_PLUGIN_H
+#define SPIELER_PLUGIN_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** Version dieser Schnittstelle, von spieler_version() zurueckzugeben */
+#define SPIELER_PLUGIN_VERSION 1
+
+/** Zustand eines Spiels, wird vom Plugin selbst definiert */
+typedef struct spieler_spiel spieler_spiel;
+
+/** Gibt SPIELER_PLUGIN_VERSION zurueck */
+int spieler_version(void);
+
+/** Beginnt ein neues Spiel; NULL bei einem Fehler */
+spieler_spiel *spieler_neu(void);
+
+/**
+ * Freiwillig: beginnt ein neues Spiel einer Variante mit `zeilen` x `spalten`
+ * Feldern und `anzahl` Schiffen, die in der Reihenfolge der Laengen
+ * `laengen` gesetzt werden; NULL bei einem Fehler.  Das Standardspiel
+ * (10 x 10 Felder, 4 Schiffe der Laenge 4) beginnt immer mit spieler_neu().
+ */
+spieler_spiel *spieler_neu_variante(int zeilen, int spalten, int anzahl,
+                                    const int *laengen);
+
+/**
+ * Setzt Schiff Nummer `schiff` (0 bis 3, in Varianten bis `anzahl` - 1):
+ * Zeile und Spalte des Anfangs sowie die Richtung, 'R' (nach rechts) oder
+ * 'U' (nach unten).
+ */
+void spieler_setzen(spieler_spiel *spiel, int schiff,
+                    int *zeile, int *spalte, char *richtung);
+
+/** Waehlt das naechste Zielfeld */
+void spieler_schiessen(spieler_spiel *spiel, int *zeile, int *spalte);
+
+/**
+ * Teilt das Ergebnis mit, wie im Protokoll ueber stdin: nach jedem Schuss
+ * 'F' (daneben), 'T' (Treffer) oder 'V' (versenkt); am Ende des Spiels 'W'
+ * (gewonnen), 'L' (verloren) oder 'U' (unentschieden).
+ */
+void spieler_ergebnis(spieler_spiel *spiel, char ergebnis);
+
+/** Beendet das Spiel und gibt seinen Zustand frei */
+void spieler_ende(spieler_spiel *spiel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPIELER_PLUGIN_H */
@@ -0,0 +1,100 @@
+/*
+ * Macht aus einem Spieler-Plugin (siehe spieler_plugin.h) ein gewoehnliches
+ * Spieler-Programm, das ueber stdin und stdout spielt:
+ *
+ *     g++ -o meine_ki meine_ki.cpp spieler_programm.cpp
+ *
+ * Bietet der Schiedsrichter gemeinsamen Speicher an (--shm), spielt es
+ * stattdessen darueber, siehe spieler_shm.h.
+ *
+ * In einer Variante nennt der Schiedsrichter Zeilen, Spalten und die Laengen
+ * der Schiffe in der Umgebungsvariable SCHIFFE_VARIANTE, z.B. "10 10 5 4 3 3
+ * 2".  Exportiert das Plugin spieler_neu_variante(), schreibt das Programm
+ * dann vor "MULTI" die Zeile "VARIANTE", sonst lehnt der Schiedsrichter es ab.
+ */
+#include "spieler_plugin.h"
+#include "spieler_shm.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Plugins ohne Varianten definieren die Funktion nicht: dann ist sie NULL
+#pragma weak spieler_neu_variante
+
+/** Liest das naechste Zeichen, das kein Leerraum ist, wie `cin >> c` */
+static bool lesen(spieler_shm::Kanal &kanal, char &c)
+{
+    if (!kanal.offen())
+        return bool(cin >> c);
+
+    string zeile;
+    size_t stelle;
+    do {
+        if (!kanal.lesen(zeile))
+            return false;
+        stelle = zeile.find_first_not_of(" \t\r");
+    } while (stelle == string::npos);
+    c = zeile[stelle];
+    return true;
+}
+
+static void schreiben(spieler_shm::Kanal &kanal, const string &zeile)
+{
+    if (kanal.offen())
+        kanal.schreiben(zeile + "\n");
+    else
+        cout << zeile << endl;
+}
+
+int main() {
+    spieler_shm::Kanal kanal;
+
+    // Ohne Variante das Standardspiel: 10 x 10 Felder, 4 Schiffe der Laenge 4
+    const char *variante = getenv("SCHIFFE_VARIANTE");
+    int zeilen = 10, spalten = 10;
+    vector<int> laengen(4, 4);
+    if (variante && spieler_neu_variante) {
+        istringstream zahlen(variante);
+        zahlen >> zeilen >> spalten;
+        laengen.clear();
+        for (int laenge; zahlen >> laenge; )
+            laengen.push_back(laenge);
+        schreiben(kanal, "VARIANTE");
+    }
+    schreiben(kanal, "MULTI");      // kann mehrere Spiele hintereinander
+
+    char c = 'N';
+    while (c == 'N') {
+        spieler_spiel *spiel = variante && spieler_neu_variante
+                ? spieler_neu_variante(zeilen, spalten, laengen.size(),
+                                       laengen.data())
+                : spieler_neu();
+        if (!spiel)
+            return 1;
+
+        int zeile, spalte;
+        char richtung;
+        for (size_t schiff = 0; schiff != laengen.size(); ++schiff) {
+            spieler_setzen(spiel, schiff, &zeile, &spalte, &richtung);
+            schreiben(kanal, to_string(zeile) + " " + to_string(spalte)
+                             + " " + richtung);
+        }
+        do {
+            spieler_schiessen(spiel, &zeile, &spalte);
+            schreiben(kanal, to_string(zeile) + " " + to_string(spalte));
+            if (!lesen(kanal, c))
+                break;
+            spieler_ergebnis(spiel, c);
+        } while (c != 'W' && c != 'L' && c != 'U');
+        spieler_ende(spiel);
+
+        // Nach dem Spiel: 'N' kuendigt ein neues Spiel an
+        if (!lesen(kanal, c))
+            break;
+    }
+}
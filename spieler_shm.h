@@ -0,0 +1,301 @@
+/*
+ * Gemeinsamer Speicher statt stdin und stdout fuer Spieler-Programme von
+ * "Schiffe versenken".
+ *
+ * Mit der Option --shm bietet der Schiedsrichter jedem Programm, das er
+ * startet, einen Speicherbereich an: Deskriptor 3, angekuendigt durch die
+ * Umgebungsvariable SCHIFFE_SHM=3.  Darin liegt je Richtung ein Ringpuffer
+ * mit genau einem Schreiber und einem Leser, so dass eine Zeile ohne
+ * Systemaufruf hin und her geht.  Wer auf den anderen wartet, sieht erst
+ * eine Weile selbst nach und schlaeft dann in futex(), bis er geweckt wird.
+ *
+ * Ein Programm nimmt das Angebot an, indem es als allererste Zeile "SHM" auf
+ * stdout schreibt; danach liest und schreibt es nur noch ueber die
+ * Ringpuffer.  Programme, die nichts davon wissen, spielen wie bisher ueber
+ * stdin und stdout.  Am einfachsten geht das mit der Klasse Kanal:
+ *
+ *     spieler_shm::Kanal kanal;      // nimmt das Angebot an, wenn es eines gibt
+ *     if (kanal.offen()) {
+ *         kanal.schreiben("MULTI\n");
+ *         std::string zeile;
+ *         while (kanal.lesen(zeile))
+ *             ...
+ *     }
+ *
+ * Siehe spieler_programm.cpp.  Nur unter Linux wird etwas angeboten.
+ */
+#ifndef SPIELER_SHM_H
+#define SPIELER_SHM_H
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <string>
+
+#include <limits.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace spieler_shm {
+
+/** Umgebungsvariable mit dem Deskriptor des Speicherbereichs */
+static const char VARIABLE[] = "SCHIFFE_SHM";
+
+/** Groesse eines Ringpuffers in Bytes, eine Zweierpotenz */
+static const uint32_t KAPAZITAET = 4096;
+
+/**
+ * Eine Richtung.  `ende` aendert nur der Schreiber, `anfang` nur der Leser;
+ * beide zaehlen immer weiter, die Position im Puffer ist der Rest modulo
+ * KAPAZITAET.  Die Zaehler liegen in eigenen Cache-Zeilen, damit Leser und
+ * Schreiber sich nicht gegenseitig ausbremsen.
+ */
+struct Ring {
+    alignas(64) std::atomic<uint32_t> anfang;   // bis hier ist gelesen
+    std::atomic<uint32_t> schreiber_schlaeft;   // wartet auf `anfang`
+    alignas(64) std::atomic<uint32_t> ende;     // bis hier ist geschrieben
+    std::atomic<uint32_t> leser_schlaeft;       // wartet auf `ende`
+    alignas(64) char daten[KAPAZITAET];
+};
+
+/** Der ganze Bereich; der Schiedsrichter legt ihn mit Nullen gefuellt an */
+struct Bereich {
+    char magie[4];                  // "SVR1"
+    uint32_t groesse;               // sizeof(Bereich)
+    Ring zum_programm;
+    Ring vom_programm;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2,
+              "Ringpuffer brauchen sperrfreie Zaehler");
+
+/** Ergebnis von warten() */
+enum Warten { GEAENDERT, ZEITABLAUF, WEG };
+
+/** Ob die andere Seite ihr Ende der Pipe `fd` geschlossen hat */
+inline bool weg(int fd)
+{
+    pollfd info;
+    info.fd = fd;
+    info.events = 0;
+    return poll(&info, 1, 0) > 0
+           && (info.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+}
+
+inline uint64_t jetzt_ns()
+{
+    timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return uint64_t(t.tv_sec) * 1000000000 + t.tv_nsec;
+}
+
+/**
+ * Wartet, bis `wort` nicht mehr `alt` ist, hoechstens `timeout` ms (-1 fuer
+ * unbegrenzt).  Die andere Seite gilt als weg, sobald sie ihr Ende der Pipe
+ * `fd` geschlossen hat; das wird nach jeweils 10 ms Schlaf geprueft.
+ */
+inline Warten warten(std::atomic<uint32_t> &wort, uint32_t alt,
+                     std::atomic<uint32_t> &schlaeft, int timeout, int fd)
+{
+    // Aufwachen dauert laenger als eine schnelle Antwort, daher erst selbst
+    // nachsehen; mit nur einem Prozessor kaeme die andere Seite so nie dran
+    static const int runden = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 4000 : 0;
+    for (int i = 0; i != runden; ++i) {
+        if (wort.load(std::memory_order_acquire) != alt)
+            return GEAENDERT;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    uint64_t frist = timeout >= 0 ? jetzt_ns() + uint64_t(timeout) * 1000000
+                                  : 0;
+    Warten ergebnis = GEAENDERT;
+    schlaeft.store(1);
+    while (wort.load() == alt) {
+        long scheibe = 10000000;
+        if (timeout >= 0) {
+            uint64_t t = jetzt_ns();
+            if (t >= frist) {
+                ergebnis = ZEITABLAUF;
+                break;
+            }
+            scheibe = std::min(long(frist - t), scheibe);
+        }
+        timespec dauer = {0, scheibe};
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wort), FUTEX_WAIT,
+                alt, &dauer, NULL, 0);
+#else
+        nanosleep(&dauer, NULL);
+#endif
+        if (wort.load() == alt && weg(fd)) {
+            ergebnis = WEG;
+            break;
+        }
+    }
+    schlaeft.store(0);
+    return ergebnis;
+}
+
+/** Weckt, wer auf `wort` wartet, falls jemand schlaeft */
+inline void wecken(std::atomic<uint32_t> &wort, std::atomic<uint32_t> &schlaeft)
+{
+    if (schlaeft.load() == 0)
+        return;
+#ifdef __linux__
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&wort), FUTEX_WAKE,
+            INT_MAX, NULL, NULL, 0);
+#endif
+}
+
+/** Platz, der im Ring frei ist */
+inline uint32_t frei(const Ring &ring)
+{
+    return KAPAZITAET - (ring.ende.load(std::memory_order_relaxed)
+                         - ring.anfang.load(std::memory_order_acquire));
+}
+
+/**
+ * Schreibt `groesse` Bytes in den Ring und wartet dazu, falls er voll ist.
+ * Gibt false zurueck, wenn die andere Seite weg ist oder `timeout` ms lang
+ * nichts gelesen hat.
+ */
+inline bool schreiben(Ring &ring, const char *text, size_t groesse,
+                      int timeout, int fd)
+{
+    while (groesse > 0) {
+        uint32_t ende = ring.ende.load(std::memory_order_relaxed);
+        uint32_t anfang = ring.anfang.load(std::memory_order_acquire);
+        uint32_t platz = KAPAZITAET - (ende - anfang);
+        if (platz == 0) {
+            if (warten(ring.anfang, anfang, ring.schreiber_schlaeft,
+                       timeout, fd) != GEAENDERT)
+                return false;
+            continue;
+        }
+        uint32_t n = uint32_t(std::min(size_t(platz), groesse));
+        uint32_t stelle = ende % KAPAZITAET;
+        uint32_t stueck = std::min(n, KAPAZITAET - stelle);
+        memcpy(ring.daten + stelle, text, stueck);
+        memcpy(ring.daten, text + stueck, n - stueck);
+        ring.ende.store(ende + n);
+        wecken(ring.ende, ring.leser_schlaeft);
+        text += n;
+        groesse -= n;
+    }
+    return true;
+}
+
+/**
+ * Liest, was im Ring steht, hoechstens `groesse` Bytes, und wartet dazu
+ * hoechstens `timeout` ms, falls er leer ist.  Gibt die Anzahl der Bytes
+ * zurueck, 0 nach Ablauf der Zeit oder -1, wenn die andere Seite weg ist.
+ */
+inline int lesen(Ring &ring, char *puffer, size_t groesse, int timeout,
+                 int fd)
+{
+    uint32_t anfang = ring.anfang.load(std::memory_order_relaxed);
+    uint32_t ende = ring.ende.load(std::memory_order_acquire);
+    if (ende == anfang) {
+        Warten ergebnis = warten(ring.ende, ende, ring.leser_schlaeft,
+                                 timeout, fd);
+        if (ergebnis != GEAENDERT)
+            return ergebnis == WEG ? -1 : 0;
+        ende = ring.ende.load(std::memory_order_acquire);
+    }
+    uint32_t n = uint32_t(std::min(size_t(ende - anfang), groesse));
+    uint32_t stelle = anfang % KAPAZITAET;
+    uint32_t stueck = std::min(n, KAPAZITAET - stelle);
+    memcpy(puffer, ring.daten + stelle, stueck);
+    memcpy(puffer + stueck, ring.daten, n - stueck);
+    ring.anfang.store(anfang + n);
+    wecken(ring.anfang, ring.schreiber_schlaeft);
+    return int(n);
+}
+
+/** Die Seite des Programms: nimmt das Angebot des Schiedsrichters an */
+class Kanal
+{
+public:
+    /**
+     * Bildet den angebotenen Bereich ab und schreibt "SHM" auf stdout, muss
+     * also vor jeder anderen Ausgabe stehen.  Ohne Angebot bleibt der Kanal
+     * geschlossen.
+     */
+    Kanal() : _bereich(nullptr), _gelesen(0), _verfuegbar(0) {
+        const char *wert = getenv(VARIABLE);
+        if (!wert)
+            return;
+        int fd = atoi(wert);
+        void *abbild = mmap(nullptr, sizeof(Bereich), PROT_READ | PROT_WRITE,
+                            MAP_SHARED, fd, 0);
+        close(fd);
+        if (abbild == MAP_FAILED)
+            return;
+        Bereich *bereich = static_cast<Bereich *>(abbild);
+        if (memcmp(bereich->magie, "SVR1", 4) != 0
+            || bereich->groesse != sizeof(Bereich)) {
+            munmap(abbild, sizeof(Bereich));
+            return;
+        }
+        _bereich = bereich;
+        std::cout << "SHM" << std::endl;
+    }
+
+    ~Kanal() {
+        if (_bereich)
+            munmap(_bereich, sizeof(Bereich));
+    }
+
+    bool offen() const { return _bereich != nullptr; }
+
+    /** Schreibt `text`, z.B. eine Zeile; false wenn der Schiedsrichter weg ist */
+    bool schreiben(const std::string &text) {
+        return spieler_shm::schreiben(_bereich->vom_programm, text.data(),
+                                      text.size(), -1, STDIN_FILENO);
+    }
+
+    /** Liest eine Zeile ohne '\n'; false wenn der Schiedsrichter weg ist */
+    bool lesen(std::string &zeile) {
+        zeile.clear();
+        for (;;) {
+            const char *anfang = _puffer + _gelesen;
+            const char *ende = static_cast<const char *>(
+                        memchr(anfang, '\n', _verfuegbar - _gelesen));
+            if (ende) {
+                zeile.append(anfang, ende);
+                _gelesen = ende - _puffer + 1;
+                return true;
+            }
+            zeile.append(anfang, _verfuegbar - _gelesen);
+            int n = spieler_shm::lesen(_bereich->zum_programm, _puffer,
+                                       sizeof(_puffer), -1, STDIN_FILENO);
+            if (n < 0)
+                return false;
+            _gelesen = 0;
+            _verfuegbar = n;
+        }
+    }
+
+private:
+    Kanal(const Kanal &) = delete;
+    Kanal &operator=(const Kanal &) = delete;
+
+    Bereich *_bereich;
+    char _puffer[KAPAZITAET];
+    size_t _gelesen, _verfuegbar;
+};
+
+}
+
+#endif /* SPIELER_SHM_H */